@@ -39,13 +39,40 @@ Blob::Blob(const cv::Mat &mat, uint32_t label)
     mat.copyTo(this->mat);
 }
 
+Blob::Blob(const cv::Mat &mat, const cv::Mat &equalizedGrayMat, uint32_t label)
+: label(label)
+{
+    mat.copyTo(this->mat);
+    equalizedGrayMat.copyTo(this->equalizedGrayMat);
+}
+
+Blob::Blob(const cv::Mat &mat, const cv::Mat &equalizedGrayMat, FramePool &framePool, uint32_t label)
+: label(label)
+, matLease(framePool.leaseCopy(mat))
+{
+    this->mat = *matLease;
+    if (!equalizedGrayMat.empty()) {
+        equalizedGrayMatLease = framePool.leaseCopy(equalizedGrayMat);
+        this->equalizedGrayMat = *equalizedGrayMatLease;
+    }
+}
+
 Blob::Blob() {
 }
 
 Blob::Blob(const Blob &other)
 : label(other.label)
+, matLease(other.matLease)
+, equalizedGrayMatLease(other.equalizedGrayMatLease)
 {
-    other.mat.copyTo(mat);
+    if (matLease) {
+        // Share the leased buffers.
+        mat = other.mat;
+        equalizedGrayMat = other.equalizedGrayMat;
+    } else {
+        other.mat.copyTo(mat);
+        other.equalizedGrayMat.copyTo(equalizedGrayMat);
+    }
 }
 
 bool Blob::isEmpty() const {
@@ -71,3 +98,7 @@ int Blob::getWidth() const {
 int Blob::getHeight() const {
     return mat.rows;
 }
+
+const cv::Mat &Blob::getEqualizedGrayMat() const {
+    return equalizedGrayMat;
+}
@@ -36,11 +36,27 @@
 
 #include <opencv2/core.hpp>
 
+#include "FramePool.h"
+
 class Blob
 {
 public:
     Blob(const cv::Mat &mat, uint32_t label = 0ul);
     
+    /**
+     * Construct a blob with a precomputed, equalized grayscale version of
+     * its image. Typically, this is an ROI of a shared, frame-level plane.
+     * Both images are copied, so the blob does not depend on the frame.
+     */
+    Blob(const cv::Mat &mat, const cv::Mat &equalizedGrayMat, uint32_t label = 0ul);
+    
+    /**
+     * Construct a blob whose images are copied into buffers leased from
+     * the pool. The equalized grayscale image may be empty.
+     * Copies of the blob share the leased buffers instead of copying them.
+     */
+    Blob(const cv::Mat &mat, const cv::Mat &equalizedGrayMat, FramePool &framePool, uint32_t label = 0ul);
+    
     /**
      * Construct an empty blob.
      */
@@ -60,10 +76,20 @@ public:
     int getWidth() const;
     int getHeight() const;
     
+    /**
+     * Get the equalized grayscale image, which is empty unless it was
+     * provided at construction.
+     */
+    const cv::Mat &getEqualizedGrayMat() const;
+    
 private:
     uint32_t label;
     
     cv::Mat mat;
+    cv::Mat equalizedGrayMat;
+    
+    FramePool::Lease matLease;
+    FramePool::Lease equalizedGrayMatLease;
 };
 
 #endif // BLOB_H
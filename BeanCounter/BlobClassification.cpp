@@ -0,0 +1,115 @@
+//
+//  BlobClassification.cpp
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "BlobClassification.h"
+
+BlobClassification::BlobClassification(size_t maxNumLabels, float rejectionDistance)
+: maxNumLabels(MAX(maxNumLabels, (size_t)1))
+, rejectionDistance(rejectionDistance)
+{
+    candidates.reserve(this->maxNumLabels);
+}
+
+void BlobClassification::addCandidate(uint32_t label, float distance) {
+    
+    // The candidates are few and sorted, so a linear scan is cheaper
+    // than a heap. Find any existing entry for the label.
+    size_t i = 0;
+    size_t numCandidates = candidates.size();
+    while (i < numCandidates && candidates[i].label != label) {
+        i++;
+    }
+    
+    if (i < numCandidates) {
+        if (distance >= candidates[i].distance) {
+            // The label already has a shorter distance.
+            return;
+        }
+    } else if (numCandidates < maxNumLabels) {
+        // Make room at the end.
+        candidates.push_back(Candidate());
+    } else if (distance < candidates[numCandidates - 1].distance) {
+        // Replace the worst candidate.
+        i = numCandidates - 1;
+    } else {
+        return;
+    }
+    
+    // Shift longer distances to the right and insert the candidate in order.
+    while (i > 0 && candidates[i - 1].distance > distance) {
+        candidates[i] = candidates[i - 1];
+        i--;
+    }
+    candidates[i].label = label;
+    candidates[i].distance = distance;
+}
+
+const std::vector<BlobClassification::Candidate> &BlobClassification::getCandidates() const {
+    return candidates;
+}
+
+uint32_t BlobClassification::getBestLabel() const {
+    if (isRejected()) {
+        return 0;
+    }
+    return candidates[0].label;
+}
+
+float BlobClassification::getBestDistance() const {
+    if (candidates.empty()) {
+        return FLT_MAX;
+    }
+    return candidates[0].distance;
+}
+
+float BlobClassification::getConfidence() const {
+    if (isRejected()) {
+        return 0.0f;
+    }
+    if (candidates.size() < 2) {
+        // There is no runner-up to cast doubt on the best label.
+        return 1.0f;
+    }
+    if (candidates[1].distance <= 0.0f) {
+        // The best label and the runner-up are tied at zero distance.
+        return 0.0f;
+    }
+    return 1.0f - candidates[0].distance / candidates[1].distance;
+}
+
+bool BlobClassification::isRejected() const {
+    // A distance of FLT_MAX means that nothing matched at all, as in
+    // the single-label classify, which leaves such a blob unidentified.
+    return candidates.empty() || candidates[0].distance >= FLT_MAX ||
+            candidates[0].distance > rejectionDistance;
+}
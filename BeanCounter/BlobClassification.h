@@ -0,0 +1,94 @@
+//
+//  BlobClassification.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef BLOB_CLASSIFICATION_H
+#define BLOB_CLASSIFICATION_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+class BlobClassification
+{
+public:
+    /**
+     * A candidate label and its distance from the detected blob.
+     */
+    struct Candidate {
+        uint32_t label;
+        float distance;
+    };
+    
+    /**
+     * Construct an empty classification that will keep the best
+     * candidates for up to maxNumLabels distinct labels.
+     */
+    BlobClassification(size_t maxNumLabels = 1, float rejectionDistance = FLT_MAX);
+    
+    /**
+     * Consider a reference's label and distance.
+     * If the label is already a candidate, keep its shorter distance.
+     */
+    void addCandidate(uint32_t label, float distance);
+    
+    /**
+     * Get the candidates, sorted from the shortest distance to the longest.
+     */
+    const std::vector<Candidate> &getCandidates() const;
+    
+    /**
+     * Get the best label, or 0 ("unidentified") if the classification is rejected.
+     */
+    uint32_t getBestLabel() const;
+    float getBestDistance() const;
+    
+    /**
+     * Get a confidence in the range [0, 1], based on the margin between
+     * the best distance and the runner-up's distance.
+     */
+    float getConfidence() const;
+    
+    /**
+     * Check whether there are no candidates, the best distance is FLT_MAX
+     * (no match), or the best distance exceeds the rejection distance.
+     */
+    bool isRejected() const;
+    
+private:
+    size_t maxNumLabels;
+    float rejectionDistance;
+    
+    std::vector<Candidate> candidates;
+};
+
+#endif // !BLOB_CLASSIFICATION_H
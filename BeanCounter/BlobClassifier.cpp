@@ -31,6 +31,9 @@
 //  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+#include <algorithm>
+#include <cmath>
+
 #include <opencv2/imgproc.hpp>
 
 #include "BlobClassifier.h"
@@ -40,13 +43,99 @@
 #endif
 
 const int HISTOGRAM_NUM_BINS_PER_CHANNEL = 32;
+const int HISTOGRAM_NUM_BINS = HISTOGRAM_NUM_BINS_PER_CHANNEL * HISTOGRAM_NUM_BINS_PER_CHANNEL * HISTOGRAM_NUM_BINS_PER_CHANNEL;
+
+// 8-bit values are mapped to 32 bins by dropping the 3 low bits.
+const int HISTOGRAM_8U_BIN_SHIFT = 3;
+
+// Large images are counted into several interleaved sub-histograms.
+// Consecutive pixels, which often share a bin, then increment
+// different counters and do not stall on each other's stores.
+// The number of sub-histograms must be a power of 2.
+const int HISTOGRAM_NUM_SUB_HISTOGRAMS = 4;
+const int HISTOGRAM_MIN_PIXELS_PER_SUB_HISTOGRAM = HISTOGRAM_NUM_BINS;
 const int HISTOGRAM_COMPARISON_METHOD = cv::HISTCMP_CHISQR_ALT;
 
 const float HISTOGRAM_DISTANCE_WEIGHT = 0.98f;
 const float KEYPOINT_MATCHING_DISTANCE_WEIGHT = 1.0f - HISTOGRAM_DISTANCE_WEIGHT;
 
-BlobClassifier::BlobClassifier()
-: clahe(cv::createCLAHE())
+// A prototype's keypoint descriptor is a near-duplicate, and is not added
+// to the bank, if its matching distance is within this threshold.
+#ifdef WITH_OPENCV_CONTRIB
+const float PROTOTYPE_DUPLICATE_KEYPOINT_DISTANCE = 0.1f; // L2, SURF
+#else
+const float PROTOTYPE_DUPLICATE_KEYPOINT_DISTANCE = 16.0f; // Hamming, ORB
+#endif
+
+// A prototype's bank holds at most this many keypoint descriptors.
+const int PROTOTYPE_MAX_NUM_KEYPOINT_DESCRIPTORS = 1000;
+
+// In medoid mode, the medoid is chosen from a uniform sample of at most
+// this many of the label's histograms, so the memory per label is bounded.
+const size_t PROTOTYPE_MAX_NUM_MEDOID_CANDIDATES = 16;
+
+// Floating-point keypoint descriptors are quantized to 8 bits by this
+// scale. SURF's descriptors have unit length, so each of their
+// components is in the range [-1, 1] and fits without clipping.
+const float QUANTIZED_KEYPOINT_DESCRIPTOR_SCALE = 127.0f;
+
+/**
+ * Match each floating-point query descriptor to its nearest quantized
+ * train descriptor, by an exhaustive search, and sum the distances.
+ * The train descriptors are rescaled on the fly, so the distances are
+ * comparable to those of the floating-point descriptors. Like the
+ * distances that the descriptor matcher reports, they are plain L2
+ * distances, not squared ones.
+ */
+static float sumQuantizedMatchDistances(const cv::Mat &queryDescriptors, const cv::Mat &trainDescriptors) {
+    
+    if (queryDescriptors.empty() || trainDescriptors.empty()) {
+        return 0.0f;
+    }
+    CV_Assert(queryDescriptors.type() == CV_32FC1 && trainDescriptors.type() == CV_8SC1 && queryDescriptors.cols == trainDescriptors.cols);
+    
+    // Expand |q - s*t|^2 as |q|^2 - 2s(q.t) + s^2|t|^2, so the inner
+    // loop is a mixed-precision dot product, which the compiler can
+    // vectorize. Find each train descriptor's scaled, squared norm once.
+    int numComponents = queryDescriptors.cols;
+    float scale = 1.0f / QUANTIZED_KEYPOINT_DESCRIPTOR_SCALE;
+    cv::AutoBuffer<float> trainSqNorms(trainDescriptors.rows);
+    for (int j = 0; j < trainDescriptors.rows; j++) {
+        const schar *t = trainDescriptors.ptr<schar>(j);
+        int sqNorm = 0;
+        for (int k = 0; k < numComponents; k++) {
+            sqNorm += t[k] * t[k];
+        }
+        trainSqNorms[j] = sqNorm * scale * scale;
+    }
+    
+    float distanceSum = 0.0f;
+    for (int i = 0; i < queryDescriptors.rows; i++) {
+        const float *q = queryDescriptors.ptr<float>(i);
+        float querySqNorm = 0.0f;
+        for (int k = 0; k < numComponents; k++) {
+            querySqNorm += q[k] * q[k];
+        }
+        float bestDistance = FLT_MAX;
+        for (int j = 0; j < trainDescriptors.rows; j++) {
+            const schar *t = trainDescriptors.ptr<schar>(j);
+            float dot = 0.0f;
+            for (int k = 0; k < numComponents; k++) {
+                dot += q[k] * t[k];
+            }
+            float distance = querySqNorm - 2.0f * scale * dot + trainSqNorms[j];
+            bestDistance = MIN(bestDistance, distance);
+        }
+        
+        // Rounding may make a squared distance slightly negative.
+        distanceSum += std::sqrt(MAX(bestDistance, 0.0f));
+    }
+    return distanceSum;
+}
+
+BlobClassifier::BlobClassifier(int maxDescriptorImageSize, size_t maxNumHotReferenceBytes, const std::string &coldReferenceDirectory)
+: maxDescriptorImageSize(maxDescriptorImageSize)
+, clahe(cv::createCLAHE())
 #ifdef WITH_OPENCV_CONTRIB
 , featureDetectorAndDescriptorExtractor(cv::xfeatures2d::SURF::create())
 , descriptorMatcher(cv::DescriptorMatcher::create("FlannBased"))
@@ -54,61 +143,121 @@ BlobClassifier::BlobClassifier()
 , featureDetectorAndDescriptorExtractor(cv::ORB::create())
 , descriptorMatcher(cv::DescriptorMatcher::create("BruteForce-HammingLUT"))
 #endif
+, referenceBlobDescriptors(maxNumHotReferenceBytes, coldReferenceDirectory)
+, prototypeMode(NoPrototypes)
+, keypointDescriptorQuantizationEnabled(false)
 {
 }
 
+void BlobClassifier::setPrototypeMode(PrototypeMode mode) {
+    prototypeMode = mode;
+    clear();
+}
+
+BlobClassifier::PrototypeMode BlobClassifier::getPrototypeMode() const {
+    return prototypeMode;
+}
+
+void BlobClassifier::setKeypointDescriptorQuantizationEnabled(bool enabled) {
+    keypointDescriptorQuantizationEnabled = enabled;
+    clear();
+}
+
+bool BlobClassifier::isKeypointDescriptorQuantizationEnabled() const {
+    return keypointDescriptorQuantizationEnabled;
+}
+
 void BlobClassifier::update(const Blob &referenceBlob) {
-    referenceBlobDescriptors.push_back(createBlobDescriptor(referenceBlob));
+    if (prototypeMode == NoPrototypes) {
+        BlobDescriptor referenceBlobDescriptor = createBlobDescriptor(referenceBlob);
+        referenceBlobDescriptors.add(BlobDescriptor(referenceBlobDescriptor.getNormalizedHistogram(), quantizeKeypointDescriptors(referenceBlobDescriptor.getKeypointDescriptors()), referenceBlobDescriptor.getLabel()));
+    } else {
+        updatePrototype(createBlobDescriptor(referenceBlob));
+    }
 }
 
 void BlobClassifier::clear() {
     referenceBlobDescriptors.clear();
+    prototypes.clear();
+    medoidSamplingRNG = cv::RNG();
 }
 
 void BlobClassifier::classify(Blob &detectedBlob) const {
+    BlobClassification classification = classify(detectedBlob, 1);
+    detectedBlob.setLabel(classification.getBestLabel());
+}
+
+BlobClassification BlobClassifier::classify(const Blob &detectedBlob, size_t maxNumLabels, float rejectionDistance) const {
     BlobDescriptor detectedBlobDescriptor = createBlobDescriptor(detectedBlob);
+    BlobClassification classification(maxNumLabels, rejectionDistance);
+    
+    // Compare the blob to each reference, or in a prototype mode, to each
+    // label's prototype.
+    size_t bestIndex = SIZE_MAX;
     float bestDistance = FLT_MAX;
-    uint32_t bestLabel = 0;
-    for (const BlobDescriptor &referenceBlobDescriptor : referenceBlobDescriptors) {
+    referenceBlobDescriptors.forEach([&](size_t index, const BlobDescriptor &referenceBlobDescriptor) {
         float distance = findDistance(detectedBlobDescriptor, referenceBlobDescriptor);
+        classification.addCandidate(referenceBlobDescriptor.getLabel(), distance);
         if (distance < bestDistance) {
+            bestIndex = index;
             bestDistance = distance;
-            bestLabel = referenceBlobDescriptor.getLabel();
         }
+    });
+    
+    // Keep the best match hot, unless it is rejected. In a prototype
+    // mode, this keeps the most recently matched labels hot.
+    if (bestIndex != SIZE_MAX && bestDistance <= rejectionDistance) {
+        referenceBlobDescriptors.recordMatch(bestIndex);
     }
-    detectedBlob.setLabel(bestLabel);
+    
+    return classification;
+}
+
+BlobReferenceStore::Stats BlobClassifier::getReferenceStats() const {
+    return referenceBlobDescriptors.getStats();
 }
 
 BlobDescriptor BlobClassifier::createBlobDescriptor(const Blob &blob) const {
     
-    const cv::Mat &mat = blob.getMat();
+    cv::Mat mat = blob.getMat();
     int numChannels = mat.channels();
     
-    // Calculate the histogram of the blob's image.
-    cv::Mat histogram;
-    int channels[] = { 0, 1, 2 };
-    int numBins[] = { HISTOGRAM_NUM_BINS_PER_CHANNEL, HISTOGRAM_NUM_BINS_PER_CHANNEL, HISTOGRAM_NUM_BINS_PER_CHANNEL };
-    float range[] = { 0.0f, 256.0f };
-    const float *ranges[] = { range, range, range };
-    cv::calcHist(&mat, 1, channels, cv::Mat(), histogram, 3, numBins, ranges);
+    // If the blob's image is too big, downscale it to a canonical size.
+    int maxSize = MAX(mat.cols, mat.rows);
+    if (maxDescriptorImageSize > 0 && maxSize > maxDescriptorImageSize) {
+        double resizeFactor = maxDescriptorImageSize / (double)maxSize;
+        cv::resize(mat, mat, cv::Size(), resizeFactor, resizeFactor, cv::INTER_AREA);
+    }
     
-    // Normalize the histogram.
-    histogram *= (1.0f / (mat.rows * mat.cols));
+    // Calculate the normalized histogram of the blob's image.
+    cv::Mat histogram;
+    calcNormalizedHistogram(mat, histogram);
     
-    // Convert the blob's image to grayscale.
     cv::Mat grayMat;
-    switch (numChannels) {
-        case 4:
-            cv::cvtColor(mat, grayMat, cv::COLOR_BGRA2GRAY);
-            break;
-        default:
-            cv::cvtColor(mat, grayMat, cv::COLOR_BGR2GRAY);
-            break;
+    const cv::Mat &equalizedGrayMat = blob.getEqualizedGrayMat();
+    if (!equalizedGrayMat.empty()) {
+        // Reuse the blob's equalized image, which has the same scale as
+        // its color image. Match it to the (possibly downscaled) copy.
+        if (equalizedGrayMat.size() == mat.size()) {
+            grayMat = equalizedGrayMat;
+        } else {
+            cv::resize(equalizedGrayMat, grayMat, mat.size(), 0.0, 0.0, cv::INTER_AREA);
+        }
+    } else {
+        // Convert the blob's image to grayscale.
+        switch (numChannels) {
+            case 4:
+                cv::cvtColor(mat, grayMat, cv::COLOR_BGRA2GRAY);
+                break;
+            default:
+                cv::cvtColor(mat, grayMat, cv::COLOR_BGR2GRAY);
+                break;
+        }
+        
+        // Adaptively equalize the grayscale image to enhance local contrast.
+        clahe->apply(grayMat, grayMat);
     }
     
-    // Adaptively equalize the grayscale image to enhance local contrast.
-    clahe->apply(grayMat, grayMat);
-    
     // Detect features in the grayscale image.
     std::vector<cv::KeyPoint> keypoints;
     featureDetectorAndDescriptorExtractor->detect(grayMat, keypoints);
@@ -120,6 +269,194 @@ BlobDescriptor BlobClassifier::createBlobDescriptor(const Blob &blob) const {
     return BlobDescriptor(histogram, keypointDescriptors, blob.getLabel());
 }
 
+void BlobClassifier::updatePrototype(const BlobDescriptor &referenceBlobDescriptor) {
+    
+    // Find the label's prototype, or create it.
+    uint32_t label = referenceBlobDescriptor.getLabel();
+    std::vector<Prototype>::iterator prototypeIt = std::find_if(prototypes.begin(), prototypes.end(), [label](const Prototype &prototype) {
+        return prototype.label == label;
+    });
+    if (prototypeIt == prototypes.end()) {
+        Prototype newPrototype;
+        newPrototype.label = label;
+        newPrototype.numReferences = 0;
+        newPrototype.referenceIndex = SIZE_MAX;
+        prototypeIt = prototypes.insert(prototypes.end(), newPrototype);
+    }
+    Prototype &prototype = *prototypeIt;
+    prototype.numReferences++;
+    
+    // The prototype's descriptor lives in the reference store, where it
+    // may be cold. Its data may be mapped read-only, so build the updated
+    // descriptor in new buffers.
+    std::shared_ptr<const BlobDescriptor> prototypeDescriptor;
+    if (prototype.referenceIndex != SIZE_MAX) {
+        prototypeDescriptor = referenceBlobDescriptors.get(prototype.referenceIndex);
+    }
+    
+    const cv::Mat &histogram = referenceBlobDescriptor.getNormalizedHistogram();
+    cv::Mat normalizedHistogram;
+    if (prototypeMode == MeanPrototypes) {
+        // Update the running mean of the histograms.
+        if (!prototypeDescriptor) {
+            normalizedHistogram = histogram.clone();
+        } else {
+            double weight = 1.0 / prototype.numReferences;
+            cv::addWeighted(prototypeDescriptor->getNormalizedHistogram(), 1.0 - weight, histogram, weight, 0.0, normalizedHistogram);
+        }
+    } else {
+        // Keep a uniform sample of the histograms by reservoir sampling.
+        // The new histogram fills a free slot, or replaces a random
+        // candidate with a probability that falls as the label grows.
+        size_t numCandidates = prototype.candidateHistograms.size();
+        size_t slot = numCandidates;
+        if (numCandidates == 0) {
+            prototype.candidateDistances.assign(PROTOTYPE_MAX_NUM_MEDOID_CANDIDATES * PROTOTYPE_MAX_NUM_MEDOID_CANDIDATES, 0.0);
+        }
+        if (numCandidates < PROTOTYPE_MAX_NUM_MEDOID_CANDIDATES) {
+            prototype.candidateHistograms.push_back(cv::Mat());
+            prototype.candidateDistanceSums.push_back(0.0);
+        } else {
+            slot = (size_t)medoidSamplingRNG.uniform(0, (int)prototype.numReferences);
+        }
+        
+        if (slot < prototype.candidateHistograms.size()) {
+            // Update each candidate's sum of distances to the others,
+            // replacing its distance to the slot's old histogram.
+            double *slotDistances = &prototype.candidateDistances[slot * PROTOTYPE_MAX_NUM_MEDOID_CANDIDATES];
+            double newDistanceSum = 0.0;
+            for (size_t i = 0; i < prototype.candidateHistograms.size(); i++) {
+                if (i == slot) {
+                    continue;
+                }
+                double distance = cv::compareHist(histogram, prototype.candidateHistograms[i], HISTOGRAM_COMPARISON_METHOD);
+                double *candidateDistances = &prototype.candidateDistances[i * PROTOTYPE_MAX_NUM_MEDOID_CANDIDATES];
+                prototype.candidateDistanceSums[i] += distance - candidateDistances[slot];
+                candidateDistances[slot] = distance;
+                slotDistances[i] = distance;
+                newDistanceSum += distance;
+            }
+            prototype.candidateHistograms[slot] = histogram;
+            prototype.candidateDistanceSums[slot] = newDistanceSum;
+        }
+        
+        // Take the candidate with the least sum as the medoid.
+        size_t medoidIndex = std::min_element(prototype.candidateDistanceSums.begin(), prototype.candidateDistanceSums.end()) - prototype.candidateDistanceSums.begin();
+        normalizedHistogram = prototype.candidateHistograms[medoidIndex];
+    }
+    
+    cv::Mat keypointDescriptors;
+    if (prototypeDescriptor) {
+        keypointDescriptors = prototypeDescriptor->getKeypointDescriptors().clone();
+    }
+    mergeKeypointDescriptors(referenceBlobDescriptor.getKeypointDescriptors(), keypointDescriptors);
+    
+    BlobDescriptor updatedPrototypeDescriptor(normalizedHistogram, keypointDescriptors, label);
+    if (prototype.referenceIndex == SIZE_MAX) {
+        prototype.referenceIndex = referenceBlobDescriptors.add(updatedPrototypeDescriptor);
+    } else {
+        referenceBlobDescriptors.replace(prototype.referenceIndex, updatedPrototypeDescriptor);
+    }
+}
+
+void BlobClassifier::mergeKeypointDescriptors(const cv::Mat &keypointDescriptors, cv::Mat &bank) const {
+    
+    if (keypointDescriptors.empty()) {
+        return;
+    }
+    
+    // The bank may be quantized. If so, the new descriptors are added in
+    // quantized form.
+    cv::Mat bankKeypointDescriptors = quantizeKeypointDescriptors(keypointDescriptors);
+    if (bank.empty()) {
+        int numRows = MIN(bankKeypointDescriptors.rows, PROTOTYPE_MAX_NUM_KEYPOINT_DESCRIPTORS);
+        bank = bankKeypointDescriptors.rowRange(0, numRows).clone();
+        return;
+    }
+    
+    // Match the new descriptors to the bank, and add the ones that are
+    // not near-duplicates, until the bank is full.
+    // A quantized bank is restored to floating-point for the matcher.
+    cv::Mat matchableBank = bank;
+    if (bank.type() != keypointDescriptors.type()) {
+        bank.convertTo(matchableBank, keypointDescriptors.type(), 1.0 / QUANTIZED_KEYPOINT_DESCRIPTOR_SCALE);
+    }
+    std::vector<cv::DMatch> keypointMatches;
+    descriptorMatcher->match(keypointDescriptors, matchableBank, keypointMatches);
+    for (const cv::DMatch &keypointMatch : keypointMatches) {
+        if (bank.rows >= PROTOTYPE_MAX_NUM_KEYPOINT_DESCRIPTORS) {
+            break;
+        }
+        if (keypointMatch.distance > PROTOTYPE_DUPLICATE_KEYPOINT_DISTANCE) {
+            bank.push_back(bankKeypointDescriptors.row(keypointMatch.queryIdx));
+        }
+    }
+}
+
+cv::Mat BlobClassifier::quantizeKeypointDescriptors(const cv::Mat &keypointDescriptors) const {
+    if (!keypointDescriptorQuantizationEnabled || keypointDescriptors.depth() != CV_32F) {
+        return keypointDescriptors;
+    }
+    cv::Mat quantizedKeypointDescriptors;
+    keypointDescriptors.convertTo(quantizedKeypointDescriptors, CV_8S, QUANTIZED_KEYPOINT_DESCRIPTOR_SCALE);
+    return quantizedKeypointDescriptors;
+}
+
+void BlobClassifier::calcNormalizedHistogram(const cv::Mat &mat, cv::Mat &histogram) const {
+    
+    int numChannels = mat.channels();
+    float scale = 1.0f / (mat.rows * mat.cols);
+    int numBins[] = { HISTOGRAM_NUM_BINS_PER_CHANNEL, HISTOGRAM_NUM_BINS_PER_CHANNEL, HISTOGRAM_NUM_BINS_PER_CHANNEL };
+    
+    if (mat.depth() != CV_8U || (numChannels != 3 && numChannels != 4)) {
+        // Use the generic implementation.
+        int channels[] = { 0, 1, 2 };
+        float range[] = { 0.0f, 256.0f };
+        const float *ranges[] = { range, range, range };
+        cv::calcHist(&mat, 1, channels, cv::Mat(), histogram, 3, numBins, ranges);
+        histogram *= scale;
+        return;
+    }
+    
+    // The image is 8-bit BGR or BGRA.
+    // Count the pixels in each bin, using shifts instead of range lookups.
+    // The layout matches cv::calcHist, with channel 0 as the slowest index.
+    int numSubHistograms = 1;
+    if (mat.rows * mat.cols >= HISTOGRAM_NUM_SUB_HISTOGRAMS * HISTOGRAM_MIN_PIXELS_PER_SUB_HISTOGRAM) {
+        numSubHistograms = HISTOGRAM_NUM_SUB_HISTOGRAMS;
+    }
+    int subHistogramMask = numSubHistograms - 1;
+    
+    // Reuse a per-thread buffer of counts, which is all zeros between calls.
+    static thread_local std::vector<uint32_t> counts(HISTOGRAM_NUM_SUB_HISTOGRAMS * HISTOGRAM_NUM_BINS, 0u);
+    const int shift1 = 2 * (8 - HISTOGRAM_8U_BIN_SHIFT);
+    const int shift2 = 8 - HISTOGRAM_8U_BIN_SHIFT;
+    for (int y = 0; y < mat.rows; y++) {
+        const uchar *pixel = mat.ptr(y);
+        for (int x = 0; x < mat.cols; x++, pixel += numChannels) {
+            int bin =
+                ((pixel[0] >> HISTOGRAM_8U_BIN_SHIFT) << shift1) |
+                ((pixel[1] >> HISTOGRAM_8U_BIN_SHIFT) << shift2) |
+                (pixel[2] >> HISTOGRAM_8U_BIN_SHIFT);
+            counts[(x & subHistogramMask) * HISTOGRAM_NUM_BINS + bin]++;
+        }
+    }
+    
+    // Merge the sub-histograms and normalize them in a single pass.
+    // Zero the counts as they are read, ready for the next call.
+    histogram.create(3, numBins, CV_32F);
+    float *dst = histogram.ptr<float>();
+    for (int bin = 0; bin < HISTOGRAM_NUM_BINS; bin++) {
+        uint32_t count = counts[bin];
+        counts[bin] = 0u;
+        for (int i = 1; i < numSubHistograms; i++) {
+            count += counts[i * HISTOGRAM_NUM_BINS + bin];
+            counts[i * HISTOGRAM_NUM_BINS + bin] = 0u;
+        }
+        dst[bin] = count * scale;
+    }
+}
+
 float BlobClassifier::findDistance(const BlobDescriptor &detectedBlobDescriptor, const BlobDescriptor &referenceBlobDescriptor) const {
     
     // Calculate the histogram distance.
@@ -127,10 +464,17 @@ float BlobClassifier::findDistance(const BlobDescriptor &detectedBlobDescriptor,
     
     // Calculate the keypoint matching distance.
     float keypointMatchingDistance = 0.0f;
-    std::vector<cv::DMatch> keypointMatches;
-    descriptorMatcher->match(detectedBlobDescriptor.getKeypointDescriptors(), referenceBlobDescriptor.getKeypointDescriptors(), keypointMatches);
-    for (const cv::DMatch &keypointMatch : keypointMatches) {
-        keypointMatchingDistance += keypointMatch.distance;
+    const cv::Mat &detectedKeypointDescriptors = detectedBlobDescriptor.getKeypointDescriptors();
+    const cv::Mat &referenceKeypointDescriptors = referenceBlobDescriptor.getKeypointDescriptors();
+    if (referenceKeypointDescriptors.type() == CV_8SC1 && detectedKeypointDescriptors.type() == CV_32FC1) {
+        // The reference's descriptors are quantized.
+        keypointMatchingDistance = sumQuantizedMatchDistances(detectedKeypointDescriptors, referenceKeypointDescriptors);
+    } else {
+        std::vector<cv::DMatch> keypointMatches;
+        descriptorMatcher->match(detectedKeypointDescriptors, referenceKeypointDescriptors, keypointMatches);
+        for (const cv::DMatch &keypointMatch : keypointMatches) {
+            keypointMatchingDistance += keypointMatch.distance;
+        }
     }
     
     return histogramDistance * HISTOGRAM_DISTANCE_WEIGHT + keypointMatchingDistance * KEYPOINT_MATCHING_DISTANCE_WEIGHT;
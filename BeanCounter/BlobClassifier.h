@@ -35,17 +35,68 @@
 #define BLOB_CLASSIFIER_H
 
 #import "Blob.h"
+#import "BlobClassification.h"
 #import "BlobDescriptor.h"
+#import "BlobReferenceStore.h"
 
 #include <opencv2/features2d.hpp>
 
 class BlobClassifier
 {
 public:
-    BlobClassifier();
+    /**
+     * How reference blobs are aggregated.
+     * With no prototypes, each reference is kept and compared separately.
+     * Otherwise, each label has one prototype, which is updated with each
+     * reference. Its histogram is the mean of the label's histograms, or
+     * the medoid of a bounded sample of them, and its keypoint
+     * descriptors are the union of the label's keypoint descriptors,
+     * without near-duplicates.
+     */
+    enum PrototypeMode {
+        NoPrototypes,
+        MeanPrototypes,
+        MedoidPrototypes
+    };
+    
+    /**
+     * Construct a classifier.
+     * If maxDescriptorImageSize is positive, any blob whose width or
+     * height exceeds it is downscaled to fit before its descriptor is
+     * created. This bounds the cost per blob, regardless of the camera's
+     * resolution. The same limit applies to reference and detected blobs.
+     * If maxNumHotReferenceBytes is positive and a cold reference
+     * directory is given, the reference descriptors that exceed the
+     * memory budget are paged out to that directory, least recently
+     * matched first.
+     */
+    BlobClassifier(int maxDescriptorImageSize = 0, size_t maxNumHotReferenceBytes = 0, const std::string &coldReferenceDirectory = "");
+    
+    /**
+     * Set how reference blobs are aggregated. This clears the
+     * classification model, so it should be set before any updates.
+     */
+    void setPrototypeMode(PrototypeMode mode);
+    PrototypeMode getPrototypeMode() const;
+    
+    /**
+     * Enable or disable quantization of the references' keypoint
+     * descriptors. If the descriptors are floating-point, such as SURF's,
+     * each reference stores them as 8-bit integers, in a quarter of the
+     * memory. Detected blobs' descriptors stay floating-point, and are
+     * matched to the quantized ones by an exhaustive, asymmetric search.
+     * Binary descriptors, such as ORB's, are not affected.
+     * This clears the classification model, so it should be set before
+     * any updates.
+     */
+    void setKeypointDescriptorQuantizationEnabled(bool enabled);
+    bool isKeypointDescriptorQuantizationEnabled() const;
     
     /**
      * Add a reference blob to the classification model.
+     * In a prototype mode, this updates the label's prototype, so that
+     * the cost of classification depends on the number of labels rather
+     * than the number of references.
      */
     void update(const Blob &referenceBlob);
     
@@ -59,10 +110,72 @@ public:
      */
     void classify(Blob &detectedBlob) const;
     
+    /**
+     * Classify a blob that was detected in a scene.
+     * Return the best candidates for up to maxNumLabels distinct labels.
+     * If the best distance exceeds rejectionDistance, the result is
+     * rejected and its best label is 0 ("unidentified").
+     * The blob itself is not modified.
+     */
+    BlobClassification classify(const Blob &detectedBlob, size_t maxNumLabels, float rejectionDistance = FLT_MAX) const;
+    
+    /**
+     * Get the reference store's statistics, including how often hot and
+     * cold references were read.
+     */
+    BlobReferenceStore::Stats getReferenceStats() const;
+    
 private:
+    struct Prototype {
+        uint32_t label;
+        size_t numReferences;
+        
+        /**
+         * The index of the prototype's descriptor in the reference store,
+         * or SIZE_MAX if it has none yet.
+         */
+        size_t referenceIndex;
+        
+        /**
+         * In medoid mode, a bounded, uniform sample of the histograms of
+         * the label's references, from which the medoid is chosen, along
+         * with their pairwise distances, and the sum of each one's
+         * distances to the others.
+         */
+        std::vector<cv::Mat> candidateHistograms;
+        std::vector<double> candidateDistances;
+        std::vector<double> candidateDistanceSums;
+    };
+    
     BlobDescriptor createBlobDescriptor(const Blob &blob) const;
+    
+    void updatePrototype(const BlobDescriptor &referenceBlobDescriptor);
+    
+    /**
+     * Add keypoint descriptors to a prototype's bank, skipping any that
+     * nearly duplicate a descriptor that is already in it.
+     */
+    void mergeKeypointDescriptors(const cv::Mat &keypointDescriptors, cv::Mat &bank) const;
+    
+    /**
+     * Quantize floating-point keypoint descriptors to 8-bit integers, if
+     * quantization is enabled. Otherwise, return them unchanged.
+     */
+    cv::Mat quantizeKeypointDescriptors(const cv::Mat &keypointDescriptors) const;
+    
+    /**
+     * Calculate the blob's color histogram and normalize it by the
+     * number of pixels. 8-bit BGR and BGRA images use a fused kernel.
+     */
+    void calcNormalizedHistogram(const cv::Mat &mat, cv::Mat &histogram) const;
     float findDistance(const BlobDescriptor &detectedBlobDescriptor, const BlobDescriptor &referenceBlobDescriptor) const;
     
+    /**
+     * The maximum width or height of a blob's image when creating its
+     * descriptor, or 0 for no limit.
+     */
+    int maxDescriptorImageSize;
+    
     /**
      * An adaptive equalizer to enhance local contrast.
      */
@@ -82,9 +195,22 @@ private:
     cv::Ptr<cv::DescriptorMatcher> descriptorMatcher;
     
     /**
-     * Descriptors of the reference blobs.
+     * Descriptors of the reference blobs, or in a prototype mode, of the
+     * labels' prototypes.
+     * Classification only changes which of them are hot, so the store is
+     * mutable.
+     */
+    mutable BlobReferenceStore referenceBlobDescriptors;
+    
+    PrototypeMode prototypeMode;
+    bool keypointDescriptorQuantizationEnabled;
+    std::vector<Prototype> prototypes;
+    
+    /**
+     * A random number generator that chooses which histograms to sample
+     * as medoid candidates. Its default seed makes the choice repeatable.
      */
-    std::vector<BlobDescriptor> referenceBlobDescriptors;
+    cv::RNG medoidSamplingRNG;
 };
 
 #endif // !BLOB_CLASSIFIER_H
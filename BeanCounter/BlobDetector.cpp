@@ -31,91 +31,832 @@
 //  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include <opencv2/imgproc.hpp>
 
 #include "BlobDetector.h"
+#include "GeomUtils.h"
 
 const double MASK_STD_DEVS_FROM_MEAN = 1.0;
 const double MASK_EROSION_KERNEL_RELATIVE_SIZE_IN_IMAGE = 0.005;
 const int MASK_NUM_EROSION_ITERATIONS = 8;
 
+// With a local background, each pixel is compared to the statistics of a
+// square tile around it. The tile's size is relative to the image's.
+const double MASK_LOCAL_TILE_RELATIVE_SIZE_IN_IMAGE = 0.25;
+
+// Masks are created in parallel row bands, each with at least this many
+// rows of its own, excluding the halo that it shares with its neighbors.
+const int MASK_MIN_ROWS_PER_BAND = 64;
+
+// Each band also has at least this many rows per row of halo on each
+// side, so that the halo adds at most half of the band's own rows.
+const int MASK_MIN_ROWS_PER_BAND_PER_HALO_ROW = 4;
+
+// There are several bands per CPU, so that the thread pool can balance
+// the load when some bands take longer than others.
+const int MASK_NUM_BANDS_PER_CPU = 4;
+
 const double BLOB_RELATIVE_MIN_SIZE_IN_IMAGE = 0.05;
 
+// In coarse-to-fine mode, each candidate is searched again at the
+// original scale, within this many resized pixels around its rectangle.
+const int REFINE_MARGIN_IN_RESIZED_PIXELS = 2;
+
+// Change detection compares the average gray levels of blocks of this
+// size, in pixels of the resized image.
+const int CHANGE_BLOCK_SIZE = 16;
+
+// A block is dirty if its average gray level differs from the reference
+// by more than this.
+const double CHANGE_THRESHOLD = 8.0;
+
+// If more than this fraction of the frame is dirty, the whole frame is
+// searched again.
+const double CHANGE_MAX_DIRTY_FRACTION = 0.5;
+
+// The whole frame is searched again at least this often, in order to
+// refresh the mask's color range and discard any accumulated drift.
+const int CHANGE_MAX_NUM_INCREMENTAL_FRAMES = 30;
+
 const cv::Scalar DRAW_RECT_COLOR(0, 255, 0); // Green
 
-void BlobDetector::detect(cv::Mat &image, std::vector<Blob> &blobs, double resizeFactor, bool draw)
+/**
+ * Append a value to a vector, counting any reallocation.
+ */
+template <typename T>
+static void pushBack(std::vector<T> &v, const T &value, size_t &numAllocations) {
+    if (v.size() == v.capacity()) {
+        numAllocations++;
+    }
+    v.push_back(value);
+}
+
+/**
+ * Assign one vector to another, counting any reallocation.
+ */
+template <typename T>
+static void assign(std::vector<T> &dst, const std::vector<T> &src, size_t &numAllocations) {
+    if (dst.capacity() < src.size()) {
+        numAllocations++;
+    }
+    dst = src;
+}
+
+/**
+ * The range of background colors, either one range for the whole image
+ * or, if the bound images are not empty, one range per pixel.
+ */
+class MaskBounds
+{
+public:
+    MaskBounds(const cv::Scalar &lowerBound, const cv::Scalar &upperBound, const cv::Mat &lowerBoundImage, const cv::Mat &upperBoundImage)
+    : lowerBound(lowerBound)
+    , upperBound(upperBound)
+    , lowerBoundImage(lowerBoundImage)
+    , upperBoundImage(upperBoundImage)
+    {
+    }
+    
+    /**
+     * Threshold the part of an image inside a rectangle.
+     */
+    void threshold(const cv::Mat &image, const cv::Rect &rect, cv::Mat &dst) const {
+        if (lowerBoundImage.empty()) {
+            cv::inRange(image(rect), lowerBound, upperBound, dst);
+        } else {
+            cv::inRange(image(rect), lowerBoundImage(rect), upperBoundImage(rect), dst);
+        }
+    }
+    
+private:
+    const cv::Scalar &lowerBound;
+    const cv::Scalar &upperBound;
+    const cv::Mat &lowerBoundImage;
+    const cv::Mat &upperBoundImage;
+};
+
+/**
+ * A parallel loop body that finds the range of background colors around
+ * each pixel in a range of rows of a rectangle, using integral images of
+ * the sum and the sum of squares of each channel. The cost per pixel is
+ * constant, regardless of the tile's size.
+ * The integral images cover sumRect, which must contain every pixel of
+ * the image within a tile's radius of the rectangle.
+ */
+class LocalBoundsCalculator : public cv::ParallelLoopBody
+{
+public:
+    LocalBoundsCalculator(const cv::Mat &sum, const cv::Mat &sqSum, const cv::Rect &sumRect, const cv::Rect &rect, int tileRadius, cv::Mat &lowerBoundImage, cv::Mat &upperBoundImage)
+    : sum(sum)
+    , sqSum(sqSum)
+    , sumRect(sumRect)
+    , rect(rect)
+    , tileRadius(tileRadius)
+    , lowerBoundImage(lowerBoundImage)
+    , upperBoundImage(upperBoundImage)
+    {
+    }
+    
+    void operator()(const cv::Range &rowRange) const {
+        int numChannels = lowerBoundImage.channels();
+        for (int y = rowRange.start; y < rowRange.end; y++) {
+            
+            // Clip the tile to the image, which is the same as clipping it
+            // to sumRect. Convert it to sumRect's coordinates.
+            int top = MAX(y - tileRadius, sumRect.y) - sumRect.y;
+            int bottom = MIN(y + tileRadius + 1, sumRect.y + sumRect.height) - sumRect.y;
+            const double *sumTop = sum.ptr<double>(top);
+            const double *sumBottom = sum.ptr<double>(bottom);
+            const double *sqSumTop = sqSum.ptr<double>(top);
+            const double *sqSumBottom = sqSum.ptr<double>(bottom);
+            uchar *lowerBounds = lowerBoundImage.ptr<uchar>(y);
+            uchar *upperBounds = upperBoundImage.ptr<uchar>(y);
+            
+            for (int x = rect.x; x < rect.x + rect.width; x++) {
+                int left = (MAX(x - tileRadius, sumRect.x) - sumRect.x) * numChannels;
+                int right = (MIN(x + tileRadius + 1, sumRect.x + sumRect.width) - sumRect.x) * numChannels;
+                double area = (double)(bottom - top) * (right - left) / numChannels;
+                for (int c = 0; c < numChannels; c++) {
+                    
+                    // Find the tile's mean and standard deviation.
+                    double tileSum = sumBottom[right + c] - sumBottom[left + c] - sumTop[right + c] + sumTop[left + c];
+                    double tileSqSum = sqSumBottom[right + c] - sqSumBottom[left + c] - sqSumTop[right + c] + sqSumTop[left + c];
+                    double mean = tileSum / area;
+                    double variance = MAX(tileSqSum / area - mean * mean, 0.0);
+                    
+                    // Find a range around the mean, rounded to the nearest
+                    // levels, as cv::inRange rounds the global range.
+                    double halfRange = MASK_STD_DEVS_FROM_MEAN * std::sqrt(variance);
+                    lowerBounds[x * numChannels + c] = cv::saturate_cast<uchar>(mean - halfRange);
+                    upperBounds[x * numChannels + c] = cv::saturate_cast<uchar>(mean + halfRange);
+                }
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &sum;
+    const cv::Mat &sqSum;
+    cv::Rect sumRect;
+    cv::Rect rect;
+    int tileRadius;
+    cv::Mat &lowerBoundImage;
+    cv::Mat &upperBoundImage;
+};
+
+/**
+ * Get the erosion's reach, in pixels.
+ */
+static int getHalo(const cv::Mat &erosionKernel) {
+    
+    // Each erosion moves a pixel's influence by up to half the kernel's
+    // size, and the iterations compound.
+    return erosionKernel.empty() ? 0 : MASK_NUM_EROSION_ITERATIONS * (erosionKernel.rows / 2);
+}
+
+/**
+ * Get a rectangle grown by the erosion's reach, within the image.
+ */
+static cv::Rect getHaloRect(const cv::Rect &rect, const cv::Mat &erosionKernel, const cv::Size &imageSize) {
+    int halo = getHalo(erosionKernel);
+    cv::Rect haloRect(rect.x - halo, rect.y - halo, rect.width + 2 * halo, rect.height + 2 * halo);
+    return haloRect & cv::Rect(0, 0, imageSize.width, imageSize.height);
+}
+
+/**
+ * Create the part of a mask inside a rectangle.
+ * The rectangle is thresholded and eroded in its own buffer, along with a
+ * halo of neighboring pixels as wide as the erosion's reach. Only the
+ * rectangle itself is copied to the mask, so the result is bit-exact with
+ * creating the whole mask at once.
+ */
+static void createMaskRegion(const cv::Mat &image, const MaskBounds &bounds, const cv::Mat &erosionKernel, const cv::Rect &rect, cv::Mat &regionMask, cv::Mat &mask) {
+    
+    cv::Rect haloRect = getHaloRect(rect, erosionKernel, image.size());
+    bounds.threshold(image, haloRect, regionMask);
+    if (!erosionKernel.empty()) {
+        cv::erode(regionMask, regionMask, erosionKernel, cv::Point(-1, -1), MASK_NUM_EROSION_ITERATIONS);
+    }
+    
+    regionMask(cv::Rect(rect.tl() - haloRect.tl(), rect.size())).copyTo(mask(rect));
+}
+
+/**
+ * A parallel loop body that creates one row band of a mask per iteration.
+ */
+class MaskBandCreator : public cv::ParallelLoopBody
+{
+public:
+    MaskBandCreator(const cv::Mat &image, const MaskBounds &bounds, const cv::Mat &erosionKernel, int numRowsPerBand, std::vector<cv::Mat> &bandMasks, cv::Mat &mask)
+    : image(image)
+    , bounds(bounds)
+    , erosionKernel(erosionKernel)
+    , numRowsPerBand(numRowsPerBand)
+    , bandMasks(bandMasks)
+    , mask(mask)
+    {
+    }
+    
+    void operator()(const cv::Range &bandRange) const {
+        for (int band = bandRange.start; band < bandRange.end; band++) {
+            int start = band * numRowsPerBand;
+            int end = MIN(start + numRowsPerBand, image.rows);
+            
+            // Each band has its own buffer, which is reused between frames.
+            cv::Rect bandRect(0, start, image.cols, end - start);
+            createMaskRegion(image, bounds, erosionKernel, bandRect, bandMasks[band], mask);
+        }
+    }
+    
+private:
+    const cv::Mat &image;
+    const MaskBounds &bounds;
+    const cv::Mat &erosionKernel;
+    int numRowsPerBand;
+    std::vector<cv::Mat> &bandMasks;
+    cv::Mat &mask;
+};
+
+BlobDetector::BlobDetector(FramePool *framePool)
+: framePool(framePool)
+, localBackgroundEnabled(false)
+, coarseToFineEnabled(false)
+, changeDetectionEnabled(false)
+, lastDetectionSearchedWholeImage(false)
+, numIncrementalFrames(0)
+, changeResizeFactor(0.0)
+, numAllocations(0)
+, numAllocationsInLastDetection(0)
+{
+}
+
+void BlobDetector::detect(cv::Mat &image, std::vector<Blob> &blobs, double resizeFactor, bool draw, FramePreprocessingCache *preprocessingCache)
 {
-    blobs.clear();
+    // Count allocations of buffers and containers, which are kept between
+    // frames and only reallocated if they need to grow.
+    numAllocations = 0;
+    size_t numPoolAllocations = (framePool == NULL) ? 0 : framePool->getNumAllocations();
+    const uchar *oldResizedImageData = resizedImage.data;
+    const uchar *oldMaskData = mask.data;
+    const uchar *oldEdgesData = edges.data;
+    const uchar *oldLowerBoundImageData = lowerBoundImage.data;
+    const uchar *oldUpperBoundImageData = upperBoundImage.data;
+    const uchar *oldChangeColorThumbnailData = changeColorThumbnail.data;
+    const uchar *oldChangeThumbnailData = changeThumbnail.data;
+    const uchar *oldReferenceThumbnailData = referenceThumbnail.data;
+    const uchar *oldDirtyBlocksData = dirtyBlocks.data;
     
+    cv::Mat detectionImage;
     if (resizeFactor == 1.0) {
-        createMask(image);
+        detectionImage = image;
+    } else if (preprocessingCache != NULL && preprocessingCache->getResizeFactor() == resizeFactor) {
+        detectionImage = preprocessingCache->getResizedImage();
     } else {
         cv::resize(image, resizedImage, cv::Size(), resizeFactor, resizeFactor, cv::INTER_AREA);
-        createMask(resizedImage);
+        detectionImage = resizedImage;
+    }
+    
+    lastDetectionSearchedWholeImage = true;
+    if (!changeDetectionEnabled) {
+        // Search the whole frame.
+        blobs.clear();
+        blobRects.clear();
+        preciseBlobRects.clear();
+        resizedBlobRects.clear();
+        createMask(detectionImage);
+        findBlobs(image, cv::Rect(0, 0, mask.cols, mask.rows), resizeFactor, preprocessingCache, blobs);
+    } else if (findDirtyRegions(detectionImage, resizeFactor)) {
+        // Only parts of the frame have changed.
+        // Search them again and keep the cached blobs elsewhere.
+        lastDetectionSearchedWholeImage = false;
+        removeBlobsInDirtyRegions();
+        if (localBackgroundEnabled) {
+            // The local statistics come from the current frame. Only
+            // update them where the dirty regions' masks will read them.
+            for (const cv::Rect &region : dirtyRegions) {
+                updateLocalBounds(detectionImage, getHaloRect(region, erosionKernel, detectionImage.size()));
+            }
+        }
+        MaskBounds bounds(maskLowerBound, maskUpperBound, lowerBoundImage, upperBoundImage);
+        for (const cv::Rect &region : dirtyRegions) {
+            createMaskRegion(detectionImage, bounds, erosionKernel, region, regionMask, mask);
+        }
+        for (const cv::Rect &region : dirtyRegions) {
+            findBlobs(image, region, resizeFactor, preprocessingCache, cachedBlobs);
+        }
+        assign(blobs, cachedBlobs, numAllocations);
+    } else {
+        // Search the whole frame and cache the blobs.
+        cachedBlobs.clear();
+        blobRects.clear();
+        preciseBlobRects.clear();
+        resizedBlobRects.clear();
+        createMask(detectionImage);
+        findBlobs(image, cv::Rect(0, 0, mask.cols, mask.rows), resizeFactor, preprocessingCache, cachedBlobs);
+        assign(blobs, cachedBlobs, numAllocations);
+        
+        // Make this frame the reference for change detection.
+        changeThumbnail.copyTo(referenceThumbnail);
+        changeResizeFactor = resizeFactor;
+        numIncrementalFrames = 0;
+    }
+    
+    if (draw) {
+        drawBlobRects(image, blobRects);
+    }
+    
+    if (framePool != NULL) {
+        numAllocations += framePool->getNumAllocations() - numPoolAllocations;
+    }
+    numAllocations += (resizedImage.data != oldResizedImageData) + (mask.data != oldMaskData) + (edges.data != oldEdgesData);
+    numAllocations += (lowerBoundImage.data != oldLowerBoundImageData) + (upperBoundImage.data != oldUpperBoundImageData);
+    numAllocations += (changeColorThumbnail.data != oldChangeColorThumbnailData) + (changeThumbnail.data != oldChangeThumbnailData);
+    numAllocations += (referenceThumbnail.data != oldReferenceThumbnailData) + (dirtyBlocks.data != oldDirtyBlocksData);
+    numAllocationsInLastDetection = numAllocations;
+}
+
+void BlobDetector::detectBatch(std::vector<cv::Mat> &images, const BatchCallback &callback, double resizeFactor, bool draw, size_t numWorkers)
+{
+    if (images.empty()) {
+        return;
+    }
+    if (numWorkers == 0) {
+        numWorkers = (size_t)MAX(cv::getNumberOfCPUs(), 1);
+    }
+    numWorkers = MIN(numWorkers, images.size());
+    
+    // Create any more detectors that are needed, and give all of them
+    // this detector's settings.
+    while (batchDetectors.size() < numWorkers) {
+        batchDetectors.emplace_back(new BlobDetector(framePool));
+    }
+    for (size_t i = 0; i < numWorkers; i++) {
+        BlobDetector &batchDetector = *batchDetectors[i];
+        if (batchDetector.localBackgroundEnabled != localBackgroundEnabled) {
+            batchDetector.setLocalBackgroundEnabled(localBackgroundEnabled);
+        }
+        if (batchDetector.coarseToFineEnabled != coarseToFineEnabled) {
+            batchDetector.setCoarseToFineEnabled(coarseToFineEnabled);
+        }
+    }
+    
+    // Each worker takes the next image until none are left. An exception
+    // must not escape a worker thread, or the process would terminate.
+    std::atomic<size_t> nextIndex(0);
+    std::mutex callbackMutex;
+    std::exception_ptr callbackException;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < numWorkers; i++) {
+        BlobDetector *batchDetector = batchDetectors[i].get();
+        workers.emplace_back([batchDetector, &images, &callback, resizeFactor, draw, &nextIndex, &callbackMutex, &callbackException] {
+            std::vector<Blob> blobs;
+            for (size_t index = nextIndex++; index < images.size(); index = nextIndex++) {
+                bool success;
+                try {
+                    batchDetector->detect(images[index], blobs, resizeFactor, draw);
+                    success = true;
+                } catch (const std::exception &) {
+                    blobs.clear();
+                    success = false;
+                }
+                
+                std::lock_guard<std::mutex> lock(callbackMutex);
+                if (callbackException) {
+                    return;
+                }
+                try {
+                    callback(index, images[index], blobs, success);
+                } catch (...) {
+                    // Stop the batch, and rethrow once the workers join.
+                    callbackException = std::current_exception();
+                    nextIndex = images.size();
+                    return;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
     }
     
+    if (callbackException) {
+        std::rethrow_exception(callbackException);
+    }
+}
+
+size_t BlobDetector::getNumAllocationsInLastDetection() const {
+    return numAllocationsInLastDetection;
+}
+
+void BlobDetector::setChangeDetectionEnabled(bool enabled) {
+    changeDetectionEnabled = enabled;
+    referenceThumbnail.release();
+    cachedBlobs.clear();
+}
+
+bool BlobDetector::isChangeDetectionEnabled() const {
+    return changeDetectionEnabled;
+}
+
+bool BlobDetector::didLastDetectionSearchWholeImage() const {
+    return lastDetectionSearchedWholeImage;
+}
+
+void BlobDetector::setCoarseToFineEnabled(bool enabled) {
+    coarseToFineEnabled = enabled;
+    
+    // The rectangles will differ, so search the whole of the next frame.
+    referenceThumbnail.release();
+    
+    if (!enabled) {
+        fineLowerBoundImage.release();
+        fineUpperBoundImage.release();
+        fineMask.release();
+        fineRegionMask.release();
+        fineEdges.release();
+        fineErosionKernel.release();
+    }
+}
+
+bool BlobDetector::isCoarseToFineEnabled() const {
+    return coarseToFineEnabled;
+}
+
+void BlobDetector::setLocalBackgroundEnabled(bool enabled) {
+    localBackgroundEnabled = enabled;
+    
+    // The masks will differ, so search the whole of the next frame.
+    referenceThumbnail.release();
+    
+    if (!enabled) {
+        lowerBoundImage.release();
+        upperBoundImage.release();
+        backgroundSum.release();
+        backgroundSqSum.release();
+    }
+}
+
+bool BlobDetector::isLocalBackgroundEnabled() const {
+    return localBackgroundEnabled;
+}
+
+const cv::Mat &BlobDetector::getMask() const {
+    return mask;
+}
+
+const std::vector<cv::Rect> &BlobDetector::getBlobRects() const {
+    return blobRects;
+}
+
+const std::vector<cv::Rect2f> &BlobDetector::getPreciseBlobRects() const {
+    return preciseBlobRects;
+}
+
+void BlobDetector::drawBlobRects(cv::Mat &image, const std::vector<cv::Rect> &blobRects) {
+    for (const cv::Rect &rect : blobRects) {
+        cv::rectangle(image, rect.tl(), rect.br(), DRAW_RECT_COLOR);
+    }
+}
+
+void BlobDetector::createMask(const cv::Mat &image) {
+    
+    if (localBackgroundEnabled) {
+        // Find the mean color and standard deviation around each pixel.
+        // Presumably, the background is the most common color nearby,
+        // even if the lighting is uneven across the image.
+        updateLocalBounds(image, cv::Rect(0, 0, image.cols, image.rows));
+    } else {
+        // Find the image's mean color.
+        // Presumably, this is the background color.
+        // Also find the standard deviation.
+        cv::Scalar meanColor;
+        cv::Scalar stdDevColor;
+        cv::meanStdDev(image, meanColor, stdDevColor);
+        
+        // Create a mask based on a range around the mean color.
+        cv::Scalar halfRange = MASK_STD_DEVS_FROM_MEAN * stdDevColor;
+        maskLowerBound = meanColor - halfRange;
+        maskUpperBound = meanColor + halfRange;
+    }
+    MaskBounds bounds(maskLowerBound, maskUpperBound, lowerBoundImage, upperBoundImage);
+    
+    // Get a kernel to erode the mask, in order to merge neighboring blobs.
+    // Reuse the kernel unless its size has changed.
+    int kernelWidth = (int)(MIN(image.cols, image.rows) * MASK_EROSION_KERNEL_RELATIVE_SIZE_IN_IMAGE);
+    if (kernelWidth <= 0) {
+        erosionKernel.release();
+    } else if (erosionKernel.cols != kernelWidth) {
+        cv::Size kernelSize(kernelWidth, kernelWidth);
+        erosionKernel = cv::getStructuringElement(cv::MORPH_RECT, kernelSize);
+    }
+    
+    // Decide how many row bands to process in parallel.
+    // The bands must be tall enough that their halos, which are
+    // processed twice, are a small part of the work.
+    int minRowsPerBand = MAX(MASK_MIN_ROWS_PER_BAND, MASK_MIN_ROWS_PER_BAND_PER_HALO_ROW * getHalo(erosionKernel));
+    int maxNumBands = cv::getNumberOfCPUs() * MASK_NUM_BANDS_PER_CPU;
+    int numBands = MIN(image.rows / minRowsPerBand, maxNumBands);
+    
+    if (numBands <= 1) {
+        // Create and erode the mask as a whole.
+        bounds.threshold(image, cv::Rect(0, 0, image.cols, image.rows), mask);
+        if (!erosionKernel.empty()) {
+            cv::erode(mask, mask, erosionKernel, cv::Point(-1, -1), MASK_NUM_EROSION_ITERATIONS);
+        }
+        return;
+    }
+    
+    // Create and erode the mask in bands.
+    int numRowsPerBand = (image.rows + numBands - 1) / numBands;
+    numBands = (image.rows + numRowsPerBand - 1) / numRowsPerBand;
+    mask.create(image.rows, image.cols, CV_8UC1);
+    maskBands.resize(numBands);
+    MaskBandCreator maskBandCreator(image, bounds, erosionKernel, numRowsPerBand, maskBands, mask);
+    cv::parallel_for_(cv::Range(0, numBands), maskBandCreator, numBands);
+}
+
+void BlobDetector::updateLocalBounds(const cv::Mat &image, const cv::Rect &rect) {
+    
+    // Find the integral images of each channel and its square, over the
+    // rectangle and the tiles around its pixels.
+    // Each tile's sums then take four lookups, however large the tile is.
+    int tileRadius = MAX((int)(MIN(image.cols, image.rows) * MASK_LOCAL_TILE_RELATIVE_SIZE_IN_IMAGE / 2), 1);
+    cv::Rect sumRect(rect.x - tileRadius, rect.y - tileRadius, rect.width + 2 * tileRadius, rect.height + 2 * tileRadius);
+    sumRect &= cv::Rect(0, 0, image.cols, image.rows);
+    // The sums are doubles, which are exact for any image size, whereas
+    // 32-bit sums would overflow above about 8 megapixels.
+    cv::integral(image(sumRect), backgroundSum, backgroundSqSum, CV_64F, CV_64F);
+    
+    // Find the range of background colors around each pixel, in parallel.
+    lowerBoundImage.create(image.rows, image.cols, image.type());
+    upperBoundImage.create(image.rows, image.cols, image.type());
+    LocalBoundsCalculator localBoundsCalculator(backgroundSum, backgroundSqSum, sumRect, rect, tileRadius, lowerBoundImage, upperBoundImage);
+    cv::parallel_for_(cv::Range(rect.y, rect.y + rect.height), localBoundsCalculator);
+}
+
+bool BlobDetector::findDirtyRegions(const cv::Mat &image, double resizeFactor) {
+    
+    // Make a grayscale thumbnail, in which each pixel is a block's average.
+    cv::Size thumbnailSize(MAX(image.cols / CHANGE_BLOCK_SIZE, 1), MAX(image.rows / CHANGE_BLOCK_SIZE, 1));
+    // A color image is resized into its own buffer and converted from
+    // there, so that neither buffer changes type and is reallocated.
+    switch (image.channels()) {
+        case 4:
+            cv::resize(image, changeColorThumbnail, thumbnailSize, 0.0, 0.0, cv::INTER_AREA);
+            cv::cvtColor(changeColorThumbnail, changeThumbnail, cv::COLOR_BGRA2GRAY);
+            break;
+        case 3:
+            cv::resize(image, changeColorThumbnail, thumbnailSize, 0.0, 0.0, cv::INTER_AREA);
+            cv::cvtColor(changeColorThumbnail, changeThumbnail, cv::COLOR_BGR2GRAY);
+            break;
+        default:
+            // Assume the image is already grayscale.
+            cv::resize(image, changeThumbnail, thumbnailSize, 0.0, 0.0, cv::INTER_AREA);
+            break;
+    }
+    
+    if (referenceThumbnail.size() != thumbnailSize || resizeFactor != changeResizeFactor || mask.size() != image.size() || numIncrementalFrames >= CHANGE_MAX_NUM_INCREMENTAL_FRAMES) {
+        // There is no valid reference, or it is due to be refreshed.
+        return false;
+    }
+    
+    // Find the blocks that differ from the reference.
+    cv::absdiff(changeThumbnail, referenceThumbnail, dirtyBlocks);
+    cv::threshold(dirtyBlocks, dirtyBlocks, CHANGE_THRESHOLD, 255.0, cv::THRESH_BINARY);
+    
+    // Find the bounding rectangles of groups of dirty blocks.
+    // Expand them by a margin that covers the erosion's reach and any
+    // pixels beyond the last whole block.
+    int margin = getHalo(erosionKernel) + CHANGE_BLOCK_SIZE;
+    cv::Rect imageRect(0, 0, image.cols, image.rows);
+    dirtyRegions.clear();
+    dirtyBlocks.copyTo(dirtyBlockEdges);
+    findContours(dirtyBlockEdges, dirtyBlockContours, cv::RETR_EXTERNAL, cv::Point());
+    for (const std::vector<cv::Point> &contour : dirtyBlockContours) {
+        cv::Rect blockRect = cv::boundingRect(contour);
+        cv::Rect region(blockRect.x * CHANGE_BLOCK_SIZE - margin, blockRect.y * CHANGE_BLOCK_SIZE - margin, blockRect.width * CHANGE_BLOCK_SIZE + 2 * margin, blockRect.height * CHANGE_BLOCK_SIZE + 2 * margin);
+        pushBack(dirtyRegions, region & imageRect, numAllocations);
+    }
+    
+    // Expand the regions to cover any cached blobs that they touch, so
+    // that a blob is either searched again in full or kept in full, and
+    // merge any overlapping regions. Either step can make a region touch
+    // more blobs or regions, so repeat them until nothing changes.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (cv::Rect &region : dirtyRegions) {
+            for (const cv::Rect &blobRect : resizedBlobRects) {
+                if ((region & blobRect).area() > 0 && (region | blobRect) != region) {
+                    region |= blobRect;
+                    changed = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < dirtyRegions.size(); i++) {
+            for (size_t j = i + 1; j < dirtyRegions.size(); j++) {
+                if ((dirtyRegions[i] & dirtyRegions[j]).area() > 0) {
+                    dirtyRegions[i] |= dirtyRegions[j];
+                    dirtyRegions.erase(dirtyRegions.begin() + j);
+                    changed = true;
+                    // Check the merged region against all the others again.
+                    j = i;
+                }
+            }
+        }
+    }
+    
+    int dirtyArea = 0;
+    for (const cv::Rect &region : dirtyRegions) {
+        dirtyArea += region.area();
+    }
+    if (dirtyArea > CHANGE_MAX_DIRTY_FRACTION * imageRect.area()) {
+        // Most of the frame has changed.
+        return false;
+    }
+    
+    // The dirty blocks will be up to date, so make them the reference.
+    changeThumbnail.copyTo(referenceThumbnail, dirtyBlocks);
+    numIncrementalFrames++;
+    return true;
+}
+
+void BlobDetector::removeBlobsInDirtyRegions() {
+    size_t numKeptBlobs = 0;
+    for (size_t i = 0; i < cachedBlobs.size(); i++) {
+        bool isDirty = false;
+        for (const cv::Rect &region : dirtyRegions) {
+            if ((region & resizedBlobRects[i]).area() > 0) {
+                isDirty = true;
+                break;
+            }
+        }
+        if (!isDirty) {
+            cachedBlobs[numKeptBlobs] = cachedBlobs[i];
+            blobRects[numKeptBlobs] = blobRects[i];
+            preciseBlobRects[numKeptBlobs] = preciseBlobRects[i];
+            resizedBlobRects[numKeptBlobs] = resizedBlobRects[i];
+            numKeptBlobs++;
+        }
+    }
+    cachedBlobs.resize(numKeptBlobs);
+    blobRects.resize(numKeptBlobs);
+    preciseBlobRects.resize(numKeptBlobs);
+    resizedBlobRects.resize(numKeptBlobs);
+}
+
+void BlobDetector::findBlobs(cv::Mat &image, const cv::Rect &region, double resizeFactor, FramePreprocessingCache *preprocessingCache, std::vector<Blob> &blobs) {
+    
     // Find the edges in the mask.
-    cv::Canny(mask, edges, 191, 255);
+    cv::Canny(mask(region), edges, 191, 255);
     
-    // Find the contours of the edges.
-    cv::findContours(edges, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+    // Find the contours of the edges, in the mask's coordinates.
+    // Their hierarchy is not needed.
+    findContours(edges, contours, cv::RETR_LIST, region.tl());
     
-    std::vector<cv::Rect> rects;
     int blobMinSize = (int)(MIN(image.rows, image.cols) * BLOB_RELATIVE_MIN_SIZE_IN_IMAGE);
-    for (std::vector<cv::Point> contour : contours) {
+    cv::Rect imageRect(0, 0, image.cols, image.rows);
+    for (const std::vector<cv::Point> &contour : contours) {
         
         // Find the contour's bounding rectangle.
-        cv::Rect rect = cv::boundingRect(contour);
-        
-        // Restore the bounding rectangle to the original scale.
-        rect.x /= resizeFactor;
-        rect.y /= resizeFactor;
-        rect.width /= resizeFactor;
-        rect.height /= resizeFactor;
+        cv::Rect resizedRect = cv::boundingRect(contour);
         
-        if (rect.width < blobMinSize || rect.height < blobMinSize) {
+        // Restore the bounding rectangle to the original scale, without
+        // rounding, so that its size is compared exactly.
+        cv::Rect2f originalRect = GeomUtils::scale(resizedRect, 1.0 / resizeFactor);
+        if (originalRect.width < blobMinSize || originalRect.height < blobMinSize) {
             continue;
         }
         
+        // Round the rectangle outward so that it covers the whole blob,
+        // and keep it inside the image. Also keep the unrounded rectangle,
+        // within the image, as the precise result.
+        cv::Rect rect = GeomUtils::roundOutward(originalRect) & imageRect;
+        cv::Rect2f preciseRect = originalRect & cv::Rect2f(imageRect);
+        if (coarseToFineEnabled && resizeFactor < 1.0) {
+            // Find the blob's boundary at the original scale, where it is
+            // exact to the pixel.
+            rect = refineBlobRect(image, rect, resizeFactor);
+            preciseRect = cv::Rect2f(rect);
+        }
+        
         // Create the blob from the sub-image inside the bounding rectangle.
-        blobs.push_back(Blob(cv::Mat(image, rect)));
+        // If a preprocessing cache is given, also give the blob the
+        // corresponding ROI of the shared, full-scale equalized plane, so
+        // that its keypoints are found at the original resolution.
+        cv::Mat blobMat(image, rect);
+        cv::Mat blobEqualizedGrayMat;
+        if (preprocessingCache != NULL) {
+            blobEqualizedGrayMat = cv::Mat(preprocessingCache->getFullScaleEqualizedImage(), rect);
+        }
+        if (blobs.size() == blobs.capacity()) {
+            numAllocations++;
+        }
+        if (framePool != NULL) {
+            blobs.emplace_back(blobMat, blobEqualizedGrayMat, *framePool);
+        } else {
+            // The blob's copies of the images are allocated.
+            blobs.emplace_back(blobMat, blobEqualizedGrayMat);
+            numAllocations += blobEqualizedGrayMat.empty() ? 1 : 2;
+        }
         
-        // Remember the bounding rectangle in order to draw it later.
-        rects.push_back(rect);
+        // Remember the bounding rectangle in order to draw it later, and
+        // at the resized scale in order to track changes.
+        pushBack(blobRects, rect, numAllocations);
+        pushBack(preciseBlobRects, preciseRect, numAllocations);
+        pushBack(resizedBlobRects, resizedRect, numAllocations);
     }
+}
+
+cv::Rect BlobDetector::refineBlobRect(const cv::Mat &image, const cv::Rect &coarseRect, double resizeFactor) {
     
-    if (draw) {
-        // Draw the bounding rectangles.
-        for (const cv::Rect &rect : rects) {
-            cv::rectangle(image, rect.tl(), rect.br(), DRAW_RECT_COLOR);
+    // Search around the coarse rectangle, allowing for its rounding and
+    // for the resizing's blur.
+    int margin = cvCeil(REFINE_MARGIN_IN_RESIZED_PIXELS / resizeFactor);
+    cv::Rect imageRect(0, 0, image.cols, image.rows);
+    cv::Rect searchRect(coarseRect.x - margin, coarseRect.y - margin, coarseRect.width + 2 * margin, coarseRect.height + 2 * margin);
+    searchRect &= imageRect;
+    
+    // Get a kernel to erode the mask, as if the whole image were searched
+    // at the original scale.
+    int kernelWidth = (int)(MIN(image.cols, image.rows) * MASK_EROSION_KERNEL_RELATIVE_SIZE_IN_IMAGE);
+    if (kernelWidth <= 0) {
+        fineErosionKernel.release();
+    } else if (fineErosionKernel.cols != kernelWidth) {
+        cv::Size kernelSize(kernelWidth, kernelWidth);
+        fineErosionKernel = cv::getStructuringElement(cv::MORPH_RECT, kernelSize);
+    }
+    
+    // Create the mask in the search rectangle, at the original scale.
+    // Use the bounds from the resized image. A local background changes
+    // slowly, so its bounds are simply enlarged.
+    cv::Rect haloRect = getHaloRect(searchRect, fineErosionKernel, image.size());
+    cv::Mat haloImage = image(haloRect);
+    if (!lowerBoundImage.empty()) {
+        cv::Rect resizedHaloRect = GeomUtils::roundOutward(GeomUtils::scale(haloRect, resizeFactor)) & cv::Rect(0, 0, lowerBoundImage.cols, lowerBoundImage.rows);
+        cv::resize(lowerBoundImage(resizedHaloRect), fineLowerBoundImage, haloRect.size(), 0.0, 0.0, cv::INTER_NEAREST);
+        cv::resize(upperBoundImage(resizedHaloRect), fineUpperBoundImage, haloRect.size(), 0.0, 0.0, cv::INTER_NEAREST);
+    } else {
+        fineLowerBoundImage.release();
+        fineUpperBoundImage.release();
+    }
+    MaskBounds bounds(maskLowerBound, maskUpperBound, fineLowerBoundImage, fineUpperBoundImage);
+    fineMask.create(haloRect.height, haloRect.width, CV_8UC1);
+    cv::Rect searchRectInHalo(searchRect.tl() - haloRect.tl(), searchRect.size());
+    createMaskRegion(haloImage, bounds, fineErosionKernel, searchRectInHalo, fineRegionMask, fineMask);
+    
+    // Find the contours at the original scale, in the image's coordinates.
+    cv::Canny(fineMask(searchRectInHalo), fineEdges, 191, 255);
+    findContours(fineEdges, fineContours, cv::RETR_LIST, searchRect.tl());
+    
+    // Take the contour that overlaps the coarse rectangle the most.
+    // Other contours in the margin may belong to neighboring blobs, so
+    // they are not merged into it. The blob's inner contours lie within
+    // its outer contour's rectangle anyway. If no contour overlaps the
+    // coarse rectangle, keep the coarse rectangle.
+    cv::Rect fineRect;
+    int bestOverlapArea = 0;
+    for (const std::vector<cv::Point> &contour : fineContours) {
+        cv::Rect contourRect = cv::boundingRect(contour);
+        int overlapArea = (contourRect & coarseRect).area();
+        if (overlapArea > bestOverlapArea || (overlapArea == bestOverlapArea && overlapArea > 0 && contourRect.area() > fineRect.area())) {
+            fineRect = contourRect;
+            bestOverlapArea = overlapArea;
         }
     }
+    return (bestOverlapArea > 0) ? fineRect : coarseRect;
 }
 
-const cv::Mat &BlobDetector::getMask() const {
-    return mask;
-}
-
-void BlobDetector::createMask(const cv::Mat &image) {
+void BlobDetector::findContours(cv::Mat &edges, std::vector<std::vector<cv::Point>> &contours, int mode, cv::Point offset) {
     
-    // Find the image's mean color.
-    // Presumably, this is the background color.
-    // Also find the standard deviation.
-    cv::Scalar meanColor;
-    cv::Scalar stdDevColor;
-    cv::meanStdDev(image, meanColor, stdDevColor);
+    // Remember the capacities of the existing contours.
+    // OpenCV resizes the contours in place, so they keep their capacities
+    // unless there are fewer contours than before.
+    size_t oldNumContours = contours.size();
+    size_t oldCapacity = contours.capacity();
+    if (contourCapacities.capacity() < oldNumContours) {
+        numAllocations++;
+    }
+    contourCapacities.resize(oldNumContours);
+    for (size_t i = 0; i < oldNumContours; i++) {
+        contourCapacities[i] = contours[i].capacity();
+    }
     
-    // Create a mask based on a range around the mean color.
-    cv::Scalar halfRange = MASK_STD_DEVS_FROM_MEAN * stdDevColor;
-    cv::Scalar lowerBound = meanColor - halfRange;
-    cv::Scalar upperBound = meanColor + halfRange;
-    cv::inRange(image, lowerBound, upperBound, mask);
+    cv::findContours(edges, contours, mode, cv::CHAIN_APPROX_SIMPLE, offset);
     
-    // Erode the mask to merge neighboring blobs.
-    int kernelWidth = (int)(MIN(image.cols, image.rows) * MASK_EROSION_KERNEL_RELATIVE_SIZE_IN_IMAGE);
-    if (kernelWidth > 0) {
-        cv::Size kernelSize(kernelWidth, kernelWidth);
-        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, kernelSize);
-        cv::erode(mask, mask, kernel, cv::Point(-1, -1), MASK_NUM_EROSION_ITERATIONS);
+    // Count any contours that grew or that were newly created.
+    if (contours.capacity() > oldCapacity) {
+        numAllocations++;
+    }
+    for (size_t i = 0; i < contours.size(); i++) {
+        if (i >= oldNumContours || contours[i].capacity() > contourCapacities[i]) {
+            numAllocations++;
+        }
     }
 }
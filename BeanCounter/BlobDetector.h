@@ -34,23 +34,214 @@
 #ifndef BLOB_DETECTOR_H
 #define BLOB_DETECTOR_H
 
+#include <functional>
+#include <memory>
+
 #include "Blob.h"
+#include "FramePool.h"
+#include "FramePreprocessingCache.h"
 
 class BlobDetector
 {
 public:
-    void detect(cv::Mat &image, std::vector<Blob> &blob, double resizeFactor = 1.0, bool draw = false);
+    /**
+     * A function that receives the blobs detected in one image of a
+     * batch, along with the image's index in the batch, and whether the
+     * detection succeeded. If it failed, there are no blobs.
+     */
+    typedef std::function<void(size_t index, cv::Mat &image, std::vector<Blob> &blobs, bool success)> BatchCallback;
+    
+    /**
+     * Construct a blob detector.
+     * If a frame pool is given, the detected blobs' images are leased
+     * from it, so that steady-state detection reuses their buffers.
+     * The pool must outlive the detector.
+     */
+    BlobDetector(FramePool *framePool = NULL);
+    
+    /**
+     * Detect blobs in the image.
+     * If a preprocessing cache is given, it must be set to the same frame.
+     * Its resized image is reused if its resize factor matches, and each
+     * blob receives a copy of its ROI of the full-scale equalized plane,
+     * so that the classifier need not convert and equalize each blob
+     * separately.
+     */
+    void detect(cv::Mat &image, std::vector<Blob> &blob, double resizeFactor = 1.0, bool draw = false, FramePreprocessingCache *preprocessingCache = NULL);
+    
+    /**
+     * Detect blobs in a batch of unrelated images, such as photos from an
+     * archive, on several worker threads. Each worker has its own
+     * detector, with its own scratch images and kernels, which are kept
+     * for later batches. The workers use this detector's settings, except
+     * that change detection is disabled.
+     * The callback is called once per image, as soon as the image is
+     * done, so the order is not guaranteed. Calls are serialized, but
+     * come from the worker threads. This blocks until the batch is done.
+     * If the detection throws for an image, such as an empty or
+     * unsupported one, that image is reported as failed and the batch
+     * continues. If the callback throws, no more images are started, and
+     * the first exception is rethrown once the workers have stopped.
+     * If numWorkers is 0, there is one worker per CPU, up to the number
+     * of images.
+     */
+    void detectBatch(std::vector<cv::Mat> &images, const BatchCallback &callback, double resizeFactor = 1.0, bool draw = false, size_t numWorkers = 0);
     
     const cv::Mat &getMask() const;
     
+    /**
+     * Get the bounding rectangles of the blobs from the last detection,
+     * at the original scale.
+     */
+    const std::vector<cv::Rect> &getBlobRects() const;
+    
+    /**
+     * Get the bounding rectangles of the blobs from the last detection,
+     * at the original scale, without rounding. Each blob's image is its
+     * precise rectangle, rounded outward to whole pixels.
+     */
+    const std::vector<cv::Rect2f> &getPreciseBlobRects() const;
+    
+    /**
+     * Draw the bounding rectangles of blobs, for example, blobs that were
+     * detected in a previous frame.
+     */
+    static void drawBlobRects(cv::Mat &image, const std::vector<cv::Rect> &blobRects);
+    
+    /**
+     * Get the number of heap allocations that the last detection made
+     * for the detector's images, contours, rectangles, and blobs,
+     * including blob buffers from the frame pool. OpenCV's internal
+     * scratch memory is not included.
+     * With a frame pool, this drops to zero once the detector is warm,
+     * unless the number or size of the blobs grows.
+     */
+    size_t getNumAllocationsInLastDetection() const;
+    
+    /**
+     * Enable or disable change detection, which suits static scenes such
+     * as a tabletop. Each frame is compared to a reference, block by
+     * block, and only the regions that changed are searched again.
+     * Blobs in the other regions are kept from previous frames.
+     */
+    void setChangeDetectionEnabled(bool enabled);
+    bool isChangeDetectionEnabled() const;
+    
+    /**
+     * Check whether the last detection searched the whole image, rather
+     * than only the regions that changed. Only such detections are
+     * representative of the cost at a given resize factor.
+     */
+    bool didLastDetectionSearchWholeImage() const;
+    
+    /**
+     * Enable or disable the local background, which suits uneven
+     * lighting. By default, the background is the mean color of the
+     * whole image. With a local background, each pixel is instead
+     * compared to the mean color and standard deviation of a tile around
+     * it, which are found in constant time per pixel from integral images.
+     */
+    void setLocalBackgroundEnabled(bool enabled);
+    bool isLocalBackgroundEnabled() const;
+    
+    /**
+     * Enable or disable coarse-to-fine detection. If the resize factor is
+     * less than 1.0, the resized image is only used to find candidate
+     * blobs. Each candidate's boundary is then found again at the
+     * original scale, in a small region around it, so that the blobs'
+     * rectangles are as accurate as a search of the original image.
+     */
+    void setCoarseToFineEnabled(bool enabled);
+    bool isCoarseToFineEnabled() const;
+    
 private:
     void createMask(const cv::Mat &image);
     
+    /**
+     * Find the range of background colors around each pixel in a
+     * rectangle. The bound images are allocated for the whole image, but
+     * only the rectangle is updated.
+     */
+    void updateLocalBounds(const cv::Mat &image, const cv::Rect &rect);
+    
+    /**
+     * Find the regions of the resized image that changed since they were
+     * last searched. Returns false if the whole image should be searched.
+     */
+    bool findDirtyRegions(const cv::Mat &image, double resizeFactor);
+    
+    void removeBlobsInDirtyRegions();
+    
+    /**
+     * Find blobs in a region of the mask, and add them and their bounding
+     * rectangles to the given blobs and to the member rectangles.
+     */
+    void findBlobs(cv::Mat &image, const cv::Rect &region, double resizeFactor, FramePreprocessingCache *preprocessingCache, std::vector<Blob> &blobs);
+    
+    /**
+     * Find a candidate blob's bounding rectangle at the original scale,
+     * given its rectangle from the resized image, scaled to the original.
+     */
+    cv::Rect refineBlobRect(const cv::Mat &image, const cv::Rect &coarseRect, double resizeFactor);
+    
+    /**
+     * Find contours, reusing the containers' capacity and counting any
+     * allocations.
+     */
+    void findContours(cv::Mat &edges, std::vector<std::vector<cv::Point>> &contours, int mode, cv::Point offset);
+    
+    FramePool *framePool;
+    
     cv::Mat resizedImage;
     cv::Mat mask;
     cv::Mat edges;
+    cv::Mat erosionKernel;
+    cv::Scalar maskLowerBound;
+    cv::Scalar maskUpperBound;
+    
+    bool localBackgroundEnabled;
+    cv::Mat backgroundSum;
+    cv::Mat backgroundSqSum;
+    cv::Mat lowerBoundImage;
+    cv::Mat upperBoundImage;
+    
+    bool coarseToFineEnabled;
+    cv::Mat fineErosionKernel;
+    cv::Mat fineLowerBoundImage;
+    cv::Mat fineUpperBoundImage;
+    cv::Mat fineMask;
+    cv::Mat fineRegionMask;
+    cv::Mat fineEdges;
+    std::vector<std::vector<cv::Point>> fineContours;
+    
+    std::vector<cv::Mat> maskBands;
+    cv::Mat regionMask;
     std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
+    std::vector<size_t> contourCapacities;
+    std::vector<cv::Rect> blobRects;
+    std::vector<cv::Rect2f> preciseBlobRects;
+    std::vector<cv::Rect> resizedBlobRects;
+    
+    bool changeDetectionEnabled;
+    bool lastDetectionSearchedWholeImage;
+    int numIncrementalFrames;
+    double changeResizeFactor;
+    cv::Mat changeColorThumbnail;
+    cv::Mat changeThumbnail;
+    cv::Mat referenceThumbnail;
+    cv::Mat dirtyBlocks;
+    cv::Mat dirtyBlockEdges;
+    std::vector<std::vector<cv::Point>> dirtyBlockContours;
+    std::vector<cv::Rect> dirtyRegions;
+    std::vector<Blob> cachedBlobs;
+    
+    size_t numAllocations;
+    size_t numAllocationsInLastDetection;
+    
+    /**
+     * The detectors of the batch workers, which are kept between batches.
+     */
+    std::vector<std::unique_ptr<BlobDetector>> batchDetectors;
 };
 
 #endif // !BLOB_DETECTOR_H
@@ -0,0 +1,393 @@
+//
+//  BlobReferenceStore.cpp
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BlobReferenceStore.h"
+
+const char COLD_MAGIC[4] = {'B', 'R', 'S', 'C'};
+
+/**
+ * The header of a cold reference's file, which is followed by the
+ * histogram's data and then the keypoint descriptors' data.
+ * Its size is a multiple of 16 bytes, so the data are aligned.
+ */
+struct ColdHeader {
+    char magic[4];
+    uint32_t label;
+    int32_t histogramDims;
+    int32_t histogramSizes[3];
+    int32_t histogramType;
+    int32_t keypointDescriptorsRows;
+    int32_t keypointDescriptorsCols;
+    int32_t keypointDescriptorsType;
+    int32_t reserved[2];
+};
+static_assert(sizeof(ColdHeader) % 16 == 0, "The cold header's size must be a multiple of 16 bytes.");
+
+/**
+ * Remove the cold files that were left by other processes, such as an
+ * earlier run of the app that did not destroy its stores.
+ * Each file's name starts with the ID of the process that wrote it.
+ */
+static void removeStaleColdFiles(const std::string &coldDirectory) {
+    DIR *dir = opendir(coldDirectory.c_str());
+    if (dir == NULL) {
+        return;
+    }
+    const char prefix[] = "reference-";
+    const char suffix[] = ".bin";
+    size_t prefixLength = sizeof(prefix) - 1;
+    size_t suffixLength = sizeof(suffix) - 1;
+    pid_t pid = getpid();
+    while (struct dirent *entry = readdir(dir)) {
+        size_t nameLength = strlen(entry->d_name);
+        if (nameLength <= prefixLength + suffixLength ||
+            strncmp(entry->d_name, prefix, prefixLength) != 0 ||
+            strcmp(entry->d_name + nameLength - suffixLength, suffix) != 0) {
+            continue;
+        }
+        if ((pid_t)strtol(entry->d_name + prefixLength, NULL, 10) == pid) {
+            // The file may belong to a live store in this process.
+            continue;
+        }
+        std::string path = coldDirectory + "/" + entry->d_name;
+        remove(path.c_str());
+    }
+    closedir(dir);
+}
+
+static size_t getDataSize(const cv::Mat &mat) {
+    return mat.total() * mat.elemSize();
+}
+
+BlobReferenceStore::BlobReferenceStore(size_t maxNumHotBytes, const std::string &coldDirectory)
+: maxNumHotBytes(maxNumHotBytes)
+, coldDirectory(coldDirectory)
+, numColdWrites(0ull)
+{
+    if (!coldDirectory.empty()) {
+        removeStaleColdFiles(coldDirectory);
+    }
+    resetStats();
+}
+
+BlobReferenceStore::~BlobReferenceStore() {
+    removeAll();
+}
+
+size_t BlobReferenceStore::add(const BlobDescriptor &descriptor) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    size_t index = entries.size();
+    Entry entry;
+    entry.hotDescriptor = std::make_shared<BlobDescriptor>(descriptor);
+    entry.numBytes = getNumBytes(descriptor);
+    hotIndices.push_front(index);
+    entry.hotPosition = hotIndices.begin();
+    entries.push_back(entry);
+    
+    stats.numReferences++;
+    stats.numHotReferences++;
+    stats.numHotBytes += entry.numBytes;
+    evict();
+    
+    return index;
+}
+
+void BlobReferenceStore::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    removeAll();
+}
+
+size_t BlobReferenceStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void BlobReferenceStore::forEach(const Visitor &visitor) {
+    
+    // Copy the entries, so that the visitor runs and the cold references
+    // are mapped without holding the lock. The hot descriptors are shared,
+    // and each cold file stays valid while it is mapped, even if it is
+    // removed meanwhile.
+    std::vector<Entry> visitedEntries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        visitedEntries = entries;
+    }
+    
+    uint64_t numHotReads = 0ull;
+    uint64_t numColdReads = 0ull;
+    for (size_t i = 0; i < visitedEntries.size(); i++) {
+        const Entry &entry = visitedEntries[i];
+        if (entry.hotDescriptor) {
+            numHotReads++;
+            visitor(i, *entry.hotDescriptor);
+        } else {
+            // Map the cold reference only while it is visited.
+            std::shared_ptr<BlobDescriptor> coldDescriptor = mapCold(entry);
+            if (coldDescriptor) {
+                numColdReads++;
+                visitor(i, *coldDescriptor);
+            }
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.numHotReads += numHotReads;
+    stats.numColdReads += numColdReads;
+}
+
+std::shared_ptr<const BlobDescriptor> BlobReferenceStore::get(size_t index) {
+    
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index >= entries.size()) {
+            return std::shared_ptr<const BlobDescriptor>();
+        }
+        entry = entries[index];
+        if (entry.hotDescriptor) {
+            stats.numHotReads++;
+            return entry.hotDescriptor;
+        }
+    }
+    
+    std::shared_ptr<BlobDescriptor> coldDescriptor = mapCold(entry);
+    if (coldDescriptor) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.numColdReads++;
+    }
+    return coldDescriptor;
+}
+
+void BlobReferenceStore::replace(size_t index, const BlobDescriptor &descriptor) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index >= entries.size()) {
+        return;
+    }
+    Entry &entry = entries[index];
+    
+    // The entry's file, if any, holds the old data, so remove it.
+    if (!entry.coldPath.empty()) {
+        remove(entry.coldPath.c_str());
+        entry.coldPath.clear();
+    }
+    
+    if (entry.hotDescriptor) {
+        stats.numHotBytes -= entry.numBytes;
+        hotIndices.splice(hotIndices.begin(), hotIndices, entry.hotPosition);
+    } else {
+        hotIndices.push_front(index);
+        entry.hotPosition = hotIndices.begin();
+        stats.numHotReferences++;
+    }
+    entry.hotDescriptor = std::make_shared<BlobDescriptor>(descriptor);
+    entry.numBytes = getNumBytes(descriptor);
+    stats.numHotBytes += entry.numBytes;
+    evict();
+}
+
+void BlobReferenceStore::recordMatch(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index >= entries.size()) {
+        return;
+    }
+    Entry &entry = entries[index];
+    stats.numMatches++;
+    
+    if (entry.hotDescriptor) {
+        // Move the entry to the front of the hot list.
+        hotIndices.splice(hotIndices.begin(), hotIndices, entry.hotPosition);
+        return;
+    }
+    
+    // Promote the entry, copying its data out of the mapping.
+    std::shared_ptr<BlobDescriptor> coldDescriptor = mapCold(entry);
+    if (!coldDescriptor) {
+        return;
+    }
+    entry.hotDescriptor = std::make_shared<BlobDescriptor>(coldDescriptor->getNormalizedHistogram().clone(), coldDescriptor->getKeypointDescriptors().clone(), coldDescriptor->getLabel());
+    hotIndices.push_front(index);
+    entry.hotPosition = hotIndices.begin();
+    stats.numHotReferences++;
+    stats.numHotBytes += entry.numBytes;
+    stats.numPromotions++;
+    evict();
+}
+
+BlobReferenceStore::Stats BlobReferenceStore::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void BlobReferenceStore::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // Keep the sizes, which describe the current contents.
+    stats.numHotReads = 0ull;
+    stats.numColdReads = 0ull;
+    stats.numMatches = 0ull;
+    stats.numPromotions = 0ull;
+    stats.numEvictions = 0ull;
+    if (entries.empty()) {
+        stats.numReferences = 0;
+        stats.numHotReferences = 0;
+        stats.numHotBytes = 0;
+    }
+}
+
+size_t BlobReferenceStore::getNumBytes(const BlobDescriptor &descriptor) {
+    return getDataSize(descriptor.getNormalizedHistogram()) + getDataSize(descriptor.getKeypointDescriptors());
+}
+
+void BlobReferenceStore::evict() {
+    if (maxNumHotBytes == 0 || coldDirectory.empty()) {
+        return;
+    }
+    
+    // Keep at least the most recent entry hot, even if it alone exceeds
+    // the budget.
+    while (stats.numHotBytes > maxNumHotBytes && hotIndices.size() > 1) {
+        size_t index = hotIndices.back();
+        Entry &entry = entries[index];
+        
+        // Write the entry's file the first time that it is evicted.
+        // The file is valid until the entry's data are replaced.
+        if (entry.coldPath.empty() && !writeCold(entry)) {
+            // The entry cannot be paged out, so keep it hot, but stop
+            // trying to evict anything else for now.
+            return;
+        }
+        
+        hotIndices.pop_back();
+        entry.hotDescriptor.reset();
+        stats.numHotReferences--;
+        stats.numHotBytes -= entry.numBytes;
+        stats.numEvictions++;
+    }
+}
+
+bool BlobReferenceStore::writeCold(Entry &entry) {
+    
+    const cv::Mat &histogram = entry.hotDescriptor->getNormalizedHistogram();
+    const cv::Mat &keypointDescriptors = entry.hotDescriptor->getKeypointDescriptors();
+    if (histogram.dims > 3 || !histogram.isContinuous() || !keypointDescriptors.isContinuous()) {
+        return false;
+    }
+    
+    ColdHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLD_MAGIC, sizeof(COLD_MAGIC));
+    header.label = entry.hotDescriptor->getLabel();
+    header.histogramDims = histogram.dims;
+    for (int i = 0; i < histogram.dims; i++) {
+        header.histogramSizes[i] = histogram.size[i];
+    }
+    header.histogramType = histogram.type();
+    header.keypointDescriptorsRows = keypointDescriptors.rows;
+    header.keypointDescriptorsCols = keypointDescriptors.cols;
+    header.keypointDescriptorsType = keypointDescriptors.type();
+    
+    // The path is unique to this process, store, and write, so a file
+    // that is still mapped is never overwritten. Each store's files are
+    // removed when it is cleared or destroyed.
+    char filename[96];
+    snprintf(filename, sizeof(filename), "/reference-%d-%p-%llu.bin", (int)getpid(), (const void *)this, (unsigned long long)numColdWrites++);
+    std::string path = coldDirectory + filename;
+    
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool success =
+        fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(histogram.data, 1, getDataSize(histogram), file) == getDataSize(histogram) &&
+        fwrite(keypointDescriptors.data, 1, getDataSize(keypointDescriptors), file) == getDataSize(keypointDescriptors);
+    success = (fclose(file) == 0) && success;
+    if (!success) {
+        remove(path.c_str());
+        return false;
+    }
+    
+    entry.coldPath = path;
+    return true;
+}
+
+std::shared_ptr<BlobDescriptor> BlobReferenceStore::mapCold(const Entry &entry) const {
+    
+    int fd = open(entry.coldPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::shared_ptr<BlobDescriptor>();
+    }
+    size_t length = sizeof(ColdHeader) + entry.numBytes;
+    void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        return std::shared_ptr<BlobDescriptor>();
+    }
+    
+    // Wrap the mapped data in read-only headers.
+    const ColdHeader *header = (const ColdHeader *)address;
+    uchar *data = (uchar *)address + sizeof(ColdHeader);
+    cv::Mat histogram(header->histogramDims, header->histogramSizes, header->histogramType, data);
+    data += getDataSize(histogram);
+    cv::Mat keypointDescriptors(header->keypointDescriptorsRows, header->keypointDescriptorsCols, header->keypointDescriptorsType, data);
+    
+    // The deleter unmaps the data once the descriptor is released.
+    return std::shared_ptr<BlobDescriptor>(new BlobDescriptor(histogram, keypointDescriptors, header->label), [address, length](BlobDescriptor *descriptor) {
+        delete descriptor;
+        munmap(address, length);
+    });
+}
+
+void BlobReferenceStore::removeAll() {
+    for (const Entry &entry : entries) {
+        if (!entry.coldPath.empty()) {
+            remove(entry.coldPath.c_str());
+        }
+    }
+    entries.clear();
+    hotIndices.clear();
+    stats.numReferences = 0;
+    stats.numHotReferences = 0;
+    stats.numHotBytes = 0;
+}
@@ -0,0 +1,184 @@
+//
+//  BlobReferenceStore.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef BLOB_REFERENCE_STORE_H
+#define BLOB_REFERENCE_STORE_H
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BlobDescriptor.h"
+
+/**
+ * A store of reference blob descriptors whose memory use is bounded.
+ * Recently matched references are kept hot, in memory. When the hot
+ * references exceed the memory budget, the least recently matched ones
+ * are paged out to files in a cold directory, and are memory-mapped
+ * whenever they are compared. A cold reference that is matched becomes
+ * hot again.
+ * Without a cold directory, or without a budget, every reference stays
+ * hot.
+ * The store is thread-safe.
+ */
+class BlobReferenceStore
+{
+public:
+    struct Stats {
+        size_t numReferences;
+        size_t numHotReferences;
+        size_t numHotBytes;
+        
+        /**
+         * The number of times that a hot or cold reference was read,
+         * respectively.
+         */
+        uint64_t numHotReads;
+        uint64_t numColdReads;
+        
+        uint64_t numMatches;
+        uint64_t numPromotions;
+        uint64_t numEvictions;
+    };
+    
+    /**
+     * A function that receives each reference and its index.
+     */
+    typedef std::function<void(size_t index, const BlobDescriptor &descriptor)> Visitor;
+    
+    /**
+     * Construct a store that keeps up to maxNumHotBytes of descriptors in
+     * memory, or any amount if maxNumHotBytes is 0. Cold references are
+     * paged out to the given directory, which must already exist.
+     */
+    BlobReferenceStore(size_t maxNumHotBytes = 0, const std::string &coldDirectory = "");
+    
+    /**
+     * Remove all references, including their files.
+     */
+    ~BlobReferenceStore();
+    
+    /**
+     * Add a reference, which starts hot. Returns its index.
+     */
+    size_t add(const BlobDescriptor &descriptor);
+    
+    /**
+     * Remove all references, including their files.
+     */
+    void clear();
+    
+    size_t size() const;
+    
+    /**
+     * Visit each reference in order of its index. Cold references are
+     * mapped for the duration of the visit.
+     * The visitor is called without holding the store's lock, and sees
+     * the references as they were when the visit started.
+     */
+    void forEach(const Visitor &visitor);
+    
+    /**
+     * Get a reference, or NULL if there is none at the index. A cold
+     * reference is mapped until the result is released. It stays cold.
+     */
+    std::shared_ptr<const BlobDescriptor> get(size_t index);
+    
+    /**
+     * Replace a reference's data. It becomes the most recently matched
+     * reference, and becomes hot if it was cold.
+     */
+    void replace(size_t index, const BlobDescriptor &descriptor);
+    
+    /**
+     * Record that a reference was the best match. It becomes the most
+     * recently matched reference, and becomes hot if it was cold.
+     */
+    void recordMatch(size_t index);
+    
+    Stats getStats() const;
+    void resetStats();
+    
+private:
+    struct Entry {
+        std::shared_ptr<BlobDescriptor> hotDescriptor;
+        std::string coldPath;
+        size_t numBytes;
+        
+        /**
+         * The entry's position in the list of hot entries, if it is hot.
+         */
+        std::list<size_t>::iterator hotPosition;
+    };
+    
+    static size_t getNumBytes(const BlobDescriptor &descriptor);
+    
+    /**
+     * Move the least recently matched hot entries to the cold tier until
+     * the hot entries fit the budget.
+     */
+    void evict();
+    
+    bool writeCold(Entry &entry);
+    std::shared_ptr<BlobDescriptor> mapCold(const Entry &entry) const;
+    
+    void removeAll();
+    
+    size_t maxNumHotBytes;
+    std::string coldDirectory;
+    
+    /**
+     * A mutex that guards all of the following members.
+     */
+    mutable std::mutex mutex;
+    
+    std::vector<Entry> entries;
+    
+    /**
+     * The indices of the hot entries, from the most to the least recently
+     * matched or added.
+     */
+    std::list<size_t> hotIndices;
+    
+    /**
+     * The number of cold files written, which makes each file's name
+     * unique.
+     */
+    uint64_t numColdWrites;
+    
+    Stats stats;
+};
+
+#endif // !BLOB_REFERENCE_STORE_H
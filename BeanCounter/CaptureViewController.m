@@ -31,6 +31,8 @@
 //  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+#import <mutex>
+
 #import <opencv2/core.hpp>
 #import <opencv2/imgcodecs/ios.h>
 #import <opencv2/imgproc.hpp>
@@ -38,15 +40,43 @@
 #import "CaptureViewController.h"
 #import "BlobClassifier.h"
 #import "BlobDetector.h"
+#import "FramePool.h"
+#import "LatestFrameScheduler.h"
+#import "ResizeFactorController.h"
 #import "ReviewViewController.h"
 #import "VideoCamera.h"
 
+// The initial and limiting resize factors for blob detection.
+// The factor adapts to keep detection within the target latency, in
+// seconds, which matches the camera's frame rate.
 const double DETECT_RESIZE_FACTOR = 0.5;
+const double DETECT_MIN_RESIZE_FACTOR = 0.25;
+const double DETECT_MAX_RESIZE_FACTOR = 1.0;
+const double DETECT_TARGET_LATENCY = 1.0 / 30.0;
+
+// Blobs are downscaled to fit this size before classification.
+// It is bigger than most of the reference images.
+const int CLASSIFY_MAX_DESCRIPTOR_IMAGE_SIZE = 512;
+
+// Reference descriptors beyond this budget are paged out to the caches
+// directory, least recently matched first.
+const size_t CLASSIFY_MAX_NUM_HOT_REFERENCE_BYTES = 16 * 1024 * 1024;
 
 @interface CaptureViewController () <CvVideoCameraDelegate> {
     BlobClassifier *blobClassifier;
     BlobDetector *blobDetector;
+    FramePool *framePool;
+    LatestFrameScheduler *frameScheduler;
+    
+    // A mutex that guards the scheduler's creation, use, and deletion.
+    std::mutex frameSchedulerMutex;
+    ResizeFactorController *resizeFactorController;
     std::vector<Blob> detectedBlobs;
+    
+    // The latest detection results to draw on the preview.
+    std::mutex detectionResultsMutex;
+    std::vector<cv::Rect> detectedBlobRects;
+    cv::Mat detectedMask;
 }
 
 @property IBOutlet UIView *backgroundView;
@@ -61,8 +91,11 @@ const double DETECT_RESIZE_FACTOR = 0.5;
 - (IBAction)onPreviewModeSelected:(UISegmentedControl *)segmentedControl;
 - (IBAction)onSwitchCameraButtonPressed;
 
+- (void)loadBlobClassifier;
+- (void)startDetection;
 - (void)refresh;
 - (void)processImage:(cv::Mat &)mat;
+- (void)detectBlobsInMat:(cv::Mat &)mat;
 - (UIImage *)imageFromCapturedMat:(const cv::Mat &)mat;
 
 @end
@@ -72,8 +105,25 @@ const double DETECT_RESIZE_FACTOR = 0.5;
 - (void)viewDidLoad {
     [super viewDidLoad];
     
-    blobDetector = new BlobDetector();
-    blobClassifier = new BlobClassifier();
+    framePool = new FramePool();
+    resizeFactorController = new ResizeFactorController(DETECT_TARGET_LATENCY, DETECT_RESIZE_FACTOR, DETECT_MIN_RESIZE_FACTOR, DETECT_MAX_RESIZE_FACTOR);
+    [self startDetection];
+    [self loadBlobClassifier];
+    
+    self.videoCamera = [[VideoCamera alloc] initWithParentView:self.backgroundView];
+    self.videoCamera.delegate = self;
+    self.videoCamera.defaultAVCaptureSessionPreset = AVCaptureSessionPresetHigh;
+    self.videoCamera.defaultFPS = 30;
+    self.videoCamera.letterboxPreview = YES;
+    self.videoCamera.defaultAVCaptureDevicePosition = AVCaptureDevicePositionBack;
+}
+
+- (void)loadBlobClassifier {
+    
+    NSString *cachesPath = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+    NSString *coldReferencePath = [cachesPath stringByAppendingPathComponent:@"ColdReferences"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:coldReferencePath withIntermediateDirectories:YES attributes:nil error:nil];
+    blobClassifier = new BlobClassifier(CLASSIFY_MAX_DESCRIPTOR_IMAGE_SIZE, CLASSIFY_MAX_NUM_HOT_REFERENCE_BYTES, [coldReferencePath UTF8String]);
     
     // Load the blob classifier's configuration from file.
     NSBundle *bundle = [NSBundle mainBundle];
@@ -99,13 +149,28 @@ const double DETECT_RESIZE_FACTOR = 0.5;
         Blob blob(mat, label);
         blobClassifier->update(blob);
     }
+}
+
+- (void)startDetection {
     
-    self.videoCamera = [[VideoCamera alloc] initWithParentView:self.backgroundView];
-    self.videoCamera.delegate = self;
-    self.videoCamera.defaultAVCaptureSessionPreset = AVCaptureSessionPresetHigh;
-    self.videoCamera.defaultFPS = 30;
-    self.videoCamera.letterboxPreview = YES;
-    self.videoCamera.defaultAVCaptureDevicePosition = AVCaptureDevicePositionBack;
+    // The caller must hold frameSchedulerMutex, unless the camera has not
+    // started yet.
+    if (blobDetector == NULL) {
+        blobDetector = new BlobDetector(framePool);
+        
+        // Typically, the camera looks at a tabletop, which is mostly static.
+        // Only search the parts of each frame that have changed.
+        blobDetector->setChangeDetectionEnabled(true);
+    }
+    
+    if (frameScheduler == NULL) {
+        // Detect blobs on a worker thread, always in the newest frame.
+        // Capture self weakly, since self owns the scheduler.
+        __weak CaptureViewController *weakSelf = self;
+        frameScheduler = new LatestFrameScheduler([weakSelf](cv::Mat &mat, uint64_t frameID) {
+            [weakSelf detectBlobsInMat:mat];
+        });
+    }
 }
 
 - (void)viewDidLayoutSubviews {
@@ -133,8 +198,20 @@ const double DETECT_RESIZE_FACTOR = 0.5;
     if ([segue.identifier isEqualToString:@"showReviewModally"]) {
         ReviewViewController *reviewViewController = segue.destinationViewController;
         
-        // Stop the camera to prevent conflicting access to the blobs.
+        // Stop the camera and wait for any ongoing detection, to prevent
+        // conflicting access to the blobs.
         [self.videoCamera stop];
+        {
+            std::lock_guard<std::mutex> lock(frameSchedulerMutex);
+            if (frameScheduler != NULL) {
+                frameScheduler->waitUntilIdle();
+            }
+        }
+        
+        if (blobClassifier == NULL) {
+            // The classifier was deleted to free memory. Reload it.
+            [self loadBlobClassifier];
+        }
         
         // Find the biggest blob.
         int biggestBlobIndex = 0;
@@ -158,17 +235,35 @@ const double DETECT_RESIZE_FACTOR = 0.5;
 - (void)didReceiveMemoryWarning {
     [super didReceiveMemoryWarning];
     
+    {
+        // The next frame recreates the scheduler and the detector.
+        std::lock_guard<std::mutex> lock(frameSchedulerMutex);
+        if (frameScheduler != NULL) {
+            // Stop detection before deleting the detector.
+            delete frameScheduler;
+            frameScheduler = NULL;
+        }
+        if (blobDetector != NULL) {
+            delete blobDetector;
+            blobDetector = NULL;
+        }
+    }
     if (blobClassifier != NULL) {
         delete blobClassifier;
         blobClassifier = NULL;
     }
-    if (blobDetector != NULL) {
-        delete blobDetector;
-        blobDetector = NULL;
+    if (framePool != NULL) {
+        // Free the idle buffers.
+        framePool->clear();
     }
 }
 
 - (void)dealloc {
+    if (frameScheduler != NULL) {
+        // Stop detection before deleting the detector.
+        delete frameScheduler;
+        frameScheduler = NULL;
+    }
     if (blobClassifier != NULL) {
         delete blobClassifier;
         blobClassifier = NULL;
@@ -177,6 +272,14 @@ const double DETECT_RESIZE_FACTOR = 0.5;
         delete blobDetector;
         blobDetector = NULL;
     }
+    if (resizeFactorController != NULL) {
+        delete resizeFactorController;
+        resizeFactorController = NULL;
+    }
+    if (framePool != NULL) {
+        delete framePool;
+        framePool = NULL;
+    }
 }
 
 - (IBAction)onTapToSetPointOfInterest:(UITapGestureRecognizer *)tapGesture {
@@ -195,6 +298,13 @@ const double DETECT_RESIZE_FACTOR = 0.5;
             self.showMask = YES;
             break;
     }
+    
+    {
+        // The mask is only kept up to date while it is shown.
+        // Discard it, so that a stale mask is never shown.
+        std::lock_guard<std::mutex> lock(detectionResultsMutex);
+        detectedMask.release();
+    }
     [self refresh];
 }
 
@@ -230,17 +340,54 @@ const double DETECT_RESIZE_FACTOR = 0.5;
             break;
     }
     
-    // Detect and draw any blobs.
-    blobDetector->detect(mat, detectedBlobs, DETECT_RESIZE_FACTOR, true);
+    // Queue the frame for blob detection on the worker thread.
+    // If detection is slower than the camera, stale frames are dropped,
+    // so the preview does not lag.
+    {
+        std::lock_guard<std::mutex> lock(frameSchedulerMutex);
+        if (frameScheduler == NULL) {
+            // Detection was stopped to free memory. Restart it.
+            [self startDetection];
+        }
+        frameScheduler->post(mat);
+    }
+    
+    // Draw the most recently detected blobs, or show their mask.
+    std::lock_guard<std::mutex> lock(detectionResultsMutex);
+    if (self.showMask) {
+        if (!detectedMask.empty()) {
+            detectedMask.copyTo(mat);
+        }
+    } else {
+        BlobDetector::drawBlobRects(mat, detectedBlobRects);
+    }
+}
+
+- (void)detectBlobsInMat:(cv::Mat &)mat {
+    
+    // Detect any blobs, at a resize factor that adapts to the latency.
+    // Only full searches are timed. Searches of the changed regions are
+    // much cheaper, and would drive the factor up until the next full
+    // search is over the budget.
+    double resizeFactor = resizeFactorController->beginFrame();
+    blobDetector->detect(mat, detectedBlobs, resizeFactor);
+    if (blobDetector->didLastDetectionSearchWholeImage()) {
+        resizeFactorController->endFrame();
+    }
+    
+    {
+        // Publish the results for drawing.
+        std::lock_guard<std::mutex> lock(detectionResultsMutex);
+        detectedBlobRects = blobDetector->getBlobRects();
+        if (self.showMask) {
+            blobDetector->getMask().copyTo(detectedMask);
+        }
+    }
     
     BOOL didDetectBlobs = (detectedBlobs.size() > 0);
     dispatch_async(dispatch_get_main_queue(), ^{
         self.classifyButton.enabled = didDetectBlobs;
     });
-    
-    if (self.showMask) {
-        blobDetector->getMask().copyTo(mat);
-    }
 }
 
 - (UIImage *)imageFromCapturedMat:(const cv::Mat &)mat {
@@ -0,0 +1,520 @@
+//
+//  BeanCounterChecks.cpp
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  A headless program that checks the detector's and classifier's
+//  invariants and measures their performance. It depends only on OpenCV.
+//  Build it from this directory with:
+//
+//    c++ -std=c++11 -O2 -I.. ../Blob.cpp ../BlobClassification.cpp
+//        ../BlobClassifier.cpp ../BlobDescriptor.cpp ../BlobDetector.cpp
+//        ../BlobReferenceStore.cpp ../FramePool.cpp
+//        ../FramePreprocessingCache.cpp ../GeomUtils.cpp
+//        BeanCounterChecks.cpp $(pkg-config --cflags --libs opencv)
+//        -o BeanCounterChecks
+//
+//  Add -DWITH_OPENCV_CONTRIB (and link opencv_xfeatures2d) to check SURF's
+//  quantized descriptors. Run it with the directory of the bundled images:
+//
+//    ./BeanCounterChecks ..
+//
+//  It prints its measurements, and exits with a nonzero status if any
+//  invariant does not hold.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "BlobClassification.h"
+#include "BlobClassifier.h"
+#include "BlobDetector.h"
+#include "FramePool.h"
+
+// These mirror the mask's parameters in BlobDetector.cpp.
+const double MASK_STD_DEVS_FROM_MEAN = 1.0;
+const double MASK_EROSION_KERNEL_RELATIVE_SIZE_IN_IMAGE = 0.005;
+const int MASK_NUM_EROSION_ITERATIONS = 8;
+
+const int NUM_TIMED_RUNS = 10;
+
+typedef std::chrono::steady_clock Clock;
+
+struct LabeledImage {
+    const char *filename;
+    uint32_t label;
+};
+
+// The references in BlobClassifierTraining.plist.
+const LabeledImage REFERENCE_IMAGES[] = {
+    { "CanadianNickel_Heads_000.png", 2 },
+    { "CanadianNickel_Tails_000.png", 2 },
+    { "CanadianDime_Heads_000.png", 3 },
+    { "CanadianDime_Tails_000.png", 3 },
+    { "CanadianQuarter_Heads_000.png", 4 },
+    { "CanadianQuarter_Tails_000.png", 4 },
+    { "Loonie_Heads_000.png", 5 },
+    { "Loonie_Tails_000.png", 5 },
+    { "Toonie_Heads_000.png", 6 },
+    { "Toonie_Tails_000.png", 6 },
+    { "PintoBean_000.png", 7 },
+    { "RomanoBean_000.png", 8 }
+};
+
+static int numFailures = 0;
+
+static void check(bool condition, const char *description) {
+    printf("  [%s] %s\n", condition ? "pass" : "FAIL", description);
+    if (!condition) {
+        numFailures++;
+    }
+}
+
+static double getMillisecondsSince(const Clock::time_point &start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * Draw a scene of dark, disjoint coins on a light, noisy background.
+ * The coins' bounding rectangles are returned in scan order.
+ * If movedCoin is not negative, that coin is shifted, as if nudged.
+ */
+static cv::Mat makeScene(cv::Size size, int type, std::vector<cv::Rect2f> &coinRects, int movedCoin = -1) {
+
+    cv::RNG rng(0x5eed);
+    cv::Mat scene(size, CV_8UC3, cv::Scalar(205, 195, 185));
+    cv::Mat noise(size, CV_8UC3);
+    rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0.0), cv::Scalar::all(4.0));
+    scene += noise;
+
+    // Place the coins on a jittered grid, so that they do not touch.
+    const int numCols = 4;
+    const int numRows = 3;
+    int cellW = size.width / numCols;
+    int cellH = size.height / numRows;
+    int maxRadius = MIN(cellW, cellH) / 4;
+    coinRects.clear();
+    for (int row = 0; row < numRows; row++) {
+        for (int col = 0; col < numCols; col++) {
+            int radius = rng.uniform(maxRadius / 2, maxRadius + 1);
+            int jitter = MAX(cellW / 2 - radius - maxRadius / 2, 1);
+            cv::Point center(col * cellW + cellW / 2 + rng.uniform(-jitter / 2, jitter / 2 + 1), row * cellH + cellH / 2);
+            if ((int)coinRects.size() == movedCoin) {
+                center.x += maxRadius / 4;
+            }
+            cv::Scalar color(rng.uniform(20, 90), rng.uniform(40, 110), rng.uniform(60, 140));
+            cv::circle(scene, center, radius, color, cv::FILLED, cv::LINE_8);
+            coinRects.push_back(cv::Rect2f((float)(center.x - radius), (float)(center.y - radius), (float)(2 * radius + 1), (float)(2 * radius + 1)));
+        }
+    }
+
+    if (type == CV_8UC4) {
+        cv::cvtColor(scene, scene, cv::COLOR_BGR2BGRA);
+    }
+    return scene;
+}
+
+/**
+ * Find the rectangle whose center is nearest to the given rectangle's.
+ */
+static const cv::Rect2f *findNearestRect(const cv::Rect2f &rect, const std::vector<cv::Rect2f> &rects) {
+    const cv::Rect2f *nearestRect = NULL;
+    float nearestDistance = FLT_MAX;
+    for (const cv::Rect2f &candidate : rects) {
+        float dx = (candidate.x + 0.5f * candidate.width) - (rect.x + 0.5f * rect.width);
+        float dy = (candidate.y + 0.5f * candidate.height) - (rect.y + 0.5f * rect.height);
+        float distance = dx * dx + dy * dy;
+        if (distance < nearestDistance) {
+            nearestRect = &candidate;
+            nearestDistance = distance;
+        }
+    }
+    return nearestRect;
+}
+
+/**
+ * Get the largest difference between two rectangles' edges.
+ */
+static float getMaxEdgeError(const cv::Rect2f &a, const cv::Rect2f &b) {
+    float left = std::fabs(a.x - b.x);
+    float top = std::fabs(a.y - b.y);
+    float right = std::fabs((a.x + a.width) - (b.x + b.width));
+    float bottom = std::fabs((a.y + a.height) - (b.y + b.height));
+    return std::max(std::max(left, top), std::max(right, bottom));
+}
+
+/**
+ * Compare the detector's banded mask to a mask that is created and
+ * eroded as a whole, with the same global bounds, and time detection at
+ * several thread counts on a 4K frame.
+ */
+static void checkMaskBands() {
+    printf("Mask bands\n");
+
+    const cv::Size sizes[] = { cv::Size(640, 480), cv::Size(1920, 1080), cv::Size(3840, 2160) };
+    for (const cv::Size &size : sizes) {
+        std::vector<cv::Rect2f> coinRects;
+        cv::Mat scene = makeScene(size, CV_8UC3, coinRects);
+
+        BlobDetector detector;
+        std::vector<Blob> blobs;
+        detector.detect(scene, blobs);
+
+        cv::Scalar meanColor;
+        cv::Scalar stdDevColor;
+        cv::meanStdDev(scene, meanColor, stdDevColor);
+        cv::Scalar halfRange = MASK_STD_DEVS_FROM_MEAN * stdDevColor;
+        cv::Mat serialMask;
+        cv::inRange(scene, meanColor - halfRange, meanColor + halfRange, serialMask);
+        int kernelWidth = (int)(MIN(size.width, size.height) * MASK_EROSION_KERNEL_RELATIVE_SIZE_IN_IMAGE);
+        if (kernelWidth > 0) {
+            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(kernelWidth, kernelWidth));
+            cv::erode(serialMask, serialMask, kernel, cv::Point(-1, -1), MASK_NUM_EROSION_ITERATIONS);
+        }
+
+        const cv::Mat &mask = detector.getMask();
+        int numDifferentPixels = (mask.size() == serialMask.size()) ? cv::countNonZero(mask != serialMask) : -1;
+        char description[128];
+        snprintf(description, sizeof(description), "%dx%d mask matches the serial mask (%d pixels differ)", size.width, size.height, numDifferentPixels);
+        check(numDifferentPixels == 0, description);
+    }
+
+    std::vector<cv::Rect2f> coinRects;
+    cv::Mat scene = makeScene(cv::Size(3840, 2160), CV_8UC3, coinRects);
+    int numCPUs = cv::getNumberOfCPUs();
+    printf("  4K detection time with %d CPUs:\n", numCPUs);
+    for (int numThreads = 1; numThreads <= 16; numThreads *= 2) {
+        cv::setNumThreads(numThreads);
+        BlobDetector detector;
+        std::vector<Blob> blobs;
+        detector.detect(scene, blobs);
+        Clock::time_point startTime = Clock::now();
+        for (int i = 0; i < NUM_TIMED_RUNS; i++) {
+            detector.detect(scene, blobs);
+        }
+        printf("    %2d threads: %8.2f ms\n", numThreads, getMillisecondsSince(startTime) / NUM_TIMED_RUNS);
+    }
+    cv::setNumThreads(numCPUs);
+}
+
+/**
+ * Check that detection with change detection and a frame pool stops
+ * allocating once it is warm, on 4-channel frames like the camera's.
+ */
+static void checkSteadyStateAllocations() {
+    printf("Steady-state allocations\n");
+
+    std::vector<cv::Rect2f> coinRects;
+    cv::Mat scenes[2] = {
+        makeScene(cv::Size(1280, 720), CV_8UC4, coinRects),
+        makeScene(cv::Size(1280, 720), CV_8UC4, coinRects, 5)
+    };
+
+    FramePool framePool;
+    BlobDetector detector(&framePool);
+    detector.setChangeDetectionEnabled(true);
+    std::vector<Blob> blobs;
+
+    // Alternate between the scenes, so that some frames are searched
+    // incrementally and some in whole.
+    const int numWarmUpFrames = 40;
+    const int numFrames = 100;
+    size_t numAllocationsAfterWarmUp = 0;
+    size_t numPoolAllocationsAfterWarmUp = 0;
+    int numIncrementalFrames = 0;
+    for (int i = 0; i < numFrames; i++) {
+        if (i == numWarmUpFrames) {
+            numPoolAllocationsAfterWarmUp = framePool.getNumAllocations();
+        }
+        cv::Mat frame = scenes[i % 2].clone();
+        detector.detect(frame, blobs);
+        if (i >= numWarmUpFrames) {
+            numAllocationsAfterWarmUp += detector.getNumAllocationsInLastDetection();
+            numIncrementalFrames += detector.didLastDetectionSearchWholeImage() ? 0 : 1;
+        }
+    }
+    size_t numPoolAllocations = framePool.getNumAllocations() - numPoolAllocationsAfterWarmUp;
+    printf("  %d of %d warm frames were searched incrementally\n", numIncrementalFrames, numFrames - numWarmUpFrames);
+
+    char description[128];
+    snprintf(description, sizeof(description), "the detector allocates nothing once warm (%zu allocations)", numAllocationsAfterWarmUp);
+    check(numAllocationsAfterWarmUp == 0, description);
+    snprintf(description, sizeof(description), "the frame pool allocates nothing once warm (%zu allocations)", numPoolAllocations);
+    check(numPoolAllocations == 0, description);
+}
+
+/**
+ * Compare the precise rectangles at several resize factors to those at
+ * full scale, and time the plain and coarse-to-fine modes.
+ */
+static void checkResizeFactors() {
+    printf("Accuracy across resize factors\n");
+
+    const cv::Size sizes[] = { cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160) };
+    const double resizeFactors[] = { 0.25, 0.5, 0.75 };
+    for (const cv::Size &size : sizes) {
+        std::vector<cv::Rect2f> coinRects;
+        cv::Mat scene = makeScene(size, CV_8UC3, coinRects);
+
+        BlobDetector fullScaleDetector;
+        std::vector<Blob> blobs;
+        fullScaleDetector.detect(scene, blobs);
+        std::vector<cv::Rect2f> fullScaleRects = fullScaleDetector.getPreciseBlobRects();
+        printf("  %dx%d: %zu blobs at full scale, %zu coins drawn\n", size.width, size.height, fullScaleRects.size(), coinRects.size());
+
+        for (int coarseToFine = 0; coarseToFine <= 1; coarseToFine++) {
+            for (double resizeFactor : resizeFactors) {
+                BlobDetector detector;
+                detector.setCoarseToFineEnabled(coarseToFine != 0);
+                detector.detect(scene, blobs, resizeFactor);
+                Clock::time_point startTime = Clock::now();
+                for (int i = 0; i < NUM_TIMED_RUNS; i++) {
+                    detector.detect(scene, blobs, resizeFactor);
+                }
+                double milliseconds = getMillisecondsSince(startTime) / NUM_TIMED_RUNS;
+
+                const std::vector<cv::Rect2f> &rects = detector.getPreciseBlobRects();
+                float meanError = 0.0f;
+                float maxError = 0.0f;
+                for (const cv::Rect2f &fullScaleRect : fullScaleRects) {
+                    const cv::Rect2f *rect = findNearestRect(fullScaleRect, rects);
+                    float error = (rect == NULL) ? FLT_MAX : getMaxEdgeError(fullScaleRect, *rect);
+                    meanError += error / fullScaleRects.size();
+                    maxError = std::max(maxError, error);
+                }
+                printf("    %-14s x%.2f: %8.2f ms, edge error mean %6.2f px, max %6.2f px\n", coarseToFine ? "coarse-to-fine" : "plain", resizeFactor, milliseconds, meanError, maxError);
+
+                char description[128];
+                snprintf(description, sizeof(description), "%s x%.2f finds the same number of blobs as full scale", coarseToFine ? "coarse-to-fine" : "plain", resizeFactor);
+                check(rects.size() == fullScaleRects.size(), description);
+            }
+        }
+    }
+}
+
+/**
+ * Compare the cost of keeping the top 5 candidates to a plain argmin.
+ */
+static void checkTopKOverhead() {
+    printf("Top-K selection overhead\n");
+
+    const int numCandidates = 100000;
+    const uint32_t numLabels = 8;
+    std::vector<BlobClassification::Candidate> candidates(numCandidates);
+    cv::RNG rng(0x5eed);
+    for (BlobClassification::Candidate &candidate : candidates) {
+        candidate.label = 1 + (uint32_t)rng.uniform(0, (int)numLabels);
+        candidate.distance = rng.uniform(0.0f, 10.0f);
+    }
+
+    Clock::time_point startTime = Clock::now();
+    uint32_t argminLabel = 0;
+    float argminDistance = FLT_MAX;
+    for (int run = 0; run < NUM_TIMED_RUNS; run++) {
+        argminDistance = FLT_MAX;
+        for (const BlobClassification::Candidate &candidate : candidates) {
+            if (candidate.distance < argminDistance) {
+                argminLabel = candidate.label;
+                argminDistance = candidate.distance;
+            }
+        }
+    }
+    double argminNanoseconds = getMillisecondsSince(startTime) * 1e6 / (NUM_TIMED_RUNS * numCandidates);
+    printf("  argmin:  %6.2f ns per candidate\n", argminNanoseconds);
+
+    const size_t maxNumLabelsValues[] = { 1, 5 };
+    for (size_t maxNumLabels : maxNumLabelsValues) {
+        BlobClassification classification;
+        startTime = Clock::now();
+        for (int run = 0; run < NUM_TIMED_RUNS; run++) {
+            classification = BlobClassification(maxNumLabels);
+            for (const BlobClassification::Candidate &candidate : candidates) {
+                classification.addCandidate(candidate.label, candidate.distance);
+            }
+        }
+        double nanoseconds = getMillisecondsSince(startTime) * 1e6 / (NUM_TIMED_RUNS * numCandidates);
+        printf("  top %zu:   %6.2f ns per candidate\n", maxNumLabels, nanoseconds);
+
+        char description[128];
+        snprintf(description, sizeof(description), "top %zu agrees with the argmin", maxNumLabels);
+        check(classification.getBestLabel() == argminLabel && classification.getBestDistance() == argminDistance, description);
+    }
+}
+
+/**
+ * Make query blobs from the references, rotated, scaled, and brightened,
+ * so that the correct label of each is known.
+ */
+static void makeQueries(const std::vector<Blob> &references, std::vector<Blob> &queries) {
+    queries.clear();
+    for (const Blob &reference : references) {
+        const cv::Mat &mat = reference.getMat();
+        cv::Point2f center(0.5f * mat.cols, 0.5f * mat.rows);
+        const double angles[] = { 30.0, 90.0, 200.0 };
+        const double scales[] = { 0.6, 1.0 };
+        for (double angle : angles) {
+            for (double scale : scales) {
+                cv::Mat query;
+                cv::warpAffine(mat, query, cv::getRotationMatrix2D(center, angle, scale), mat.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+                query.convertTo(query, -1, 1.0, 12.0);
+                queries.push_back(Blob(query, reference.getLabel()));
+            }
+        }
+    }
+}
+
+struct ClassifierResult {
+    double accuracy;
+    double millisecondsPerQuery;
+    float meanBestDistance;
+    size_t numHotBytes;
+    size_t numTopKMismatches;
+    std::vector<uint32_t> labels;
+};
+
+static ClassifierResult runClassifier(BlobClassifier &classifier, const std::vector<Blob> &references, const std::vector<Blob> &queries) {
+    for (const Blob &reference : references) {
+        classifier.update(reference);
+    }
+
+    ClassifierResult result;
+    result.numHotBytes = classifier.getReferenceStats().numHotBytes;
+    result.meanBestDistance = 0.0f;
+    result.numTopKMismatches = 0;
+    size_t numCorrect = 0;
+    Clock::time_point startTime = Clock::now();
+    for (const Blob &query : queries) {
+        BlobClassification classification = classifier.classify(query, 1);
+        result.labels.push_back(classification.getBestLabel());
+        result.meanBestDistance += classification.getBestDistance() / queries.size();
+        if (classification.getBestLabel() == query.getLabel()) {
+            numCorrect++;
+        }
+    }
+    result.millisecondsPerQuery = getMillisecondsSince(startTime) / queries.size();
+    result.accuracy = numCorrect / (double)queries.size();
+
+    // Keeping more candidates must not change the best one.
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (classifier.classify(queries[i], 5).getBestLabel() != result.labels[i]) {
+            result.numTopKMismatches++;
+        }
+    }
+    return result;
+}
+
+static double getAgreement(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+    size_t numAgreements = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        numAgreements += (a[i] == b[i]) ? 1 : 0;
+    }
+    return numAgreements / (double)a.size();
+}
+
+/**
+ * Measure the accuracy and speed of the descriptors' canonical size and,
+ * with SURF, of quantized keypoint descriptors, on the bundled images.
+ */
+static void checkClassifier(const std::string &imageDirectory) {
+    printf("Classifier\n");
+
+    std::vector<Blob> references;
+    for (const LabeledImage &labeledImage : REFERENCE_IMAGES) {
+        cv::Mat mat = cv::imread(imageDirectory + "/" + labeledImage.filename, cv::IMREAD_COLOR);
+        if (mat.empty()) {
+            printf("  cannot read %s\n", labeledImage.filename);
+            numFailures++;
+            return;
+        }
+        references.push_back(Blob(mat, labeledImage.label));
+    }
+    std::vector<Blob> queries;
+    makeQueries(references, queries);
+    printf("  %zu references, %zu queries\n", references.size(), queries.size());
+
+    const int maxDescriptorImageSizes[] = { 0, 512, 256, 128 };
+    ClassifierResult fullSizeResult;
+    for (int maxDescriptorImageSize : maxDescriptorImageSizes) {
+        BlobClassifier classifier(maxDescriptorImageSize);
+        ClassifierResult result = runClassifier(classifier, references, queries);
+        if (maxDescriptorImageSize == 0) {
+            fullSizeResult = result;
+        }
+        printf("    max size %4d: accuracy %5.1f%%, agreement with full size %5.1f%%, %8.2f ms per query\n", maxDescriptorImageSize, 100.0 * result.accuracy, 100.0 * getAgreement(result.labels, fullSizeResult.labels), result.millisecondsPerQuery);
+
+        char description[128];
+        snprintf(description, sizeof(description), "max size %d: the top 5's best label is the top 1's (%zu mismatches)", maxDescriptorImageSize, result.numTopKMismatches);
+        check(result.numTopKMismatches == 0, description);
+    }
+
+#ifdef WITH_OPENCV_CONTRIB
+    // Compare quantized SURF descriptors to the FLANN search of floating-
+    // point descriptors that they replace.
+    BlobClassifier flannClassifier;
+    ClassifierResult flannResult = runClassifier(flannClassifier, references, queries);
+    BlobClassifier quantizedClassifier;
+    quantizedClassifier.setKeypointDescriptorQuantizationEnabled(true);
+    ClassifierResult quantizedResult = runClassifier(quantizedClassifier, references, queries);
+    printf("    FLANN:     accuracy %5.1f%%, %8.2f ms per query, %zu reference bytes, mean best distance %.4f\n", 100.0 * flannResult.accuracy, flannResult.millisecondsPerQuery, flannResult.numHotBytes, flannResult.meanBestDistance);
+    printf("    quantized: accuracy %5.1f%%, %8.2f ms per query, %zu reference bytes, mean best distance %.4f\n", 100.0 * quantizedResult.accuracy, quantizedResult.millisecondsPerQuery, quantizedResult.numHotBytes, quantizedResult.meanBestDistance);
+    printf("    agreement between FLANN and quantized: %5.1f%%\n", 100.0 * getAgreement(flannResult.labels, quantizedResult.labels));
+
+    // The quantized distances are exhaustive, so they may be slightly
+    // shorter than FLANN's approximate ones, but their scale must match.
+    float distanceRatio = quantizedResult.meanBestDistance / flannResult.meanBestDistance;
+    char description[128];
+    snprintf(description, sizeof(description), "quantized distances have FLANN's scale (ratio %.3f)", distanceRatio);
+    check(distanceRatio > 0.8f && distanceRatio < 1.25f, description);
+#else
+    printf("    quantization: skipped, since ORB's descriptors are binary\n");
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    std::string imageDirectory = (argc > 1) ? argv[1] : "..";
+
+    checkMaskBands();
+    checkSteadyStateAllocations();
+    checkResizeFactors();
+    checkTopKOverhead();
+    checkClassifier(imageDirectory);
+
+    printf("%d failures\n", numFailures);
+    return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+//
+//  FramePool.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ * A pool of recycled image buffers.
+ * Buffers are grouped into size classes, spaced a quarter of an octave
+ * apart, so that images of similar but unequal sizes, such as blobs or
+ * faces from consecutive frames, can reuse the same buffers. Each buffer
+ * is allocated by OpenCV, so its data are aligned for SIMD.
+ * A buffer is recycled together with its image header and its lease's
+ * reference count, so once the pool is warm, leasing does not allocate
+ * at all.
+ * The pool is thread-safe.
+ */
+class FramePool
+{
+public:
+    /**
+     * A continuous image whose data belong to a pooled buffer.
+     * The buffer returns to the pool when the last copy of the lease is
+     * released. The image must not be reallocated, for example, by
+     * passing it as the output of an OpenCV function that needs a
+     * different size or type.
+     */
+    typedef std::shared_ptr<cv::Mat> Lease;
+    
+    /**
+     * Construct a pool that keeps up to maxNumIdleBuffersPerSize unused
+     * buffers of each size class. Any more are freed by the next lease of
+     * their size class.
+     */
+    FramePool(size_t maxNumIdleBuffersPerSize = 8);
+    
+    /**
+     * Lease an image of the given size and type.
+     * Its initial contents are undefined.
+     */
+    Lease lease(int rows, int cols, int type);
+    
+    /**
+     * Lease an image and copy the given image into it.
+     */
+    Lease leaseCopy(const cv::Mat &src);
+    
+    /**
+     * Free all idle buffers.
+     */
+    void clear();
+    
+    /**
+     * Get the number of buffers that the pool has allocated, each with
+     * its header and reference count.
+     * Once the pool is warm, this stops increasing.
+     */
+    size_t getNumAllocations() const;
+    
+    size_t getNumIdleBuffers() const;
+    
+private:
+    /**
+     * A buffer and the header of the image that is leased from it.
+     * Each lease shares the slot's reference count, so a slot is idle
+     * when the pool holds the only reference. A lease keeps its slot
+     * alive, so it may safely outlive the pool.
+     */
+    struct Slot {
+        cv::Mat buffer;
+        cv::Mat header;
+    };
+    
+    static size_t getBufferSize(size_t numBytes);
+    
+    /**
+     * Check whether a slot is idle. The pool's mutex must be held.
+     */
+    static bool isIdle(const std::shared_ptr<Slot> &slot);
+    
+    /**
+     * A mutex that guards all of the following members.
+     */
+    mutable std::mutex mutex;
+    
+    /**
+     * All of the slots, leased or idle, by buffer size.
+     */
+    std::map<size_t, std::vector<std::shared_ptr<Slot>>> slots;
+    size_t maxNumIdleBuffersPerSize;
+    size_t numAllocations;
+};
+
+#endif // !FRAME_POOL_H
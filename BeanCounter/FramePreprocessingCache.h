@@ -0,0 +1,127 @@
+//
+//  FramePreprocessingCache.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef FRAME_PREPROCESSING_CACHE_H
+#define FRAME_PREPROCESSING_CACHE_H
+
+#include <opencv2/imgproc.hpp>
+
+/**
+ * A cache of a frame's grayscale and equalized planes.
+ * The planes are computed lazily, at most once per frame ID, so that
+ * several detectors and descriptors can share them. Consumers take ROIs
+ * of the shared planes instead of converting and equalizing their own
+ * sub-images.
+ */
+class FramePreprocessingCache
+{
+public:
+    /**
+     * Construct a cache that equalizes with the given CLAHE, or with
+     * cv::equalizeHist if the CLAHE is empty.
+     */
+    FramePreprocessingCache(const cv::Ptr<cv::CLAHE> &clahe = cv::Ptr<cv::CLAHE>());
+    
+    /**
+     * Set the current frame.
+     * If the frame ID and resize factor match the cached ones, the cached
+     * planes are kept. Otherwise, they are invalidated.
+     * The frame's data are not copied, so the frame must outlive its use
+     * in the cache.
+     */
+    void setFrame(const cv::Mat &image, uint64_t frameID, double resizeFactor = 1.0);
+    
+    /**
+     * Forget the current frame and its planes.
+     */
+    void clear();
+    
+    bool hasFrame() const;
+    uint64_t getFrameID() const;
+    double getResizeFactor() const;
+    
+    /**
+     * Get the frame at its original scale.
+     */
+    cv::Mat &getImage();
+    
+    /**
+     * Get the frame, resized by the resize factor.
+     */
+    const cv::Mat &getResizedImage();
+    
+    /**
+     * Get the resized frame in grayscale.
+     */
+    const cv::Mat &getGrayImage();
+    
+    /**
+     * Get the resized, grayscale frame after equalization.
+     */
+    const cv::Mat &getEqualizedImage();
+    
+    /**
+     * Get the frame in grayscale at its original scale.
+     */
+    const cv::Mat &getFullScaleGrayImage();
+    
+    /**
+     * Get the grayscale frame at its original scale after equalization.
+     * If the resize factor is 1.0, this is the same as the equalized image.
+     */
+    const cv::Mat &getFullScaleEqualizedImage();
+    
+private:
+    cv::Ptr<cv::CLAHE> clahe;
+    
+    uint64_t frameID;
+    double resizeFactor;
+    
+    bool isResizedImageValid;
+    bool isGrayImageValid;
+    bool isEqualizedImageValid;
+    bool isFullScaleGrayImageValid;
+    bool isFullScaleEqualizedImageValid;
+    
+    cv::Mat image;
+    cv::Mat resizedImage;
+    cv::Mat grayImage;
+    cv::Mat equalizedImage;
+    cv::Mat fullScaleGrayImage;
+    cv::Mat fullScaleEqualizedImage;
+    
+    void convertToGray(const cv::Mat &src, cv::Mat &dst) const;
+    void equalize(const cv::Mat &src, cv::Mat &dst) const;
+};
+
+#endif // !FRAME_PREPROCESSING_CACHE_H
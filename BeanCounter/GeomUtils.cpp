@@ -0,0 +1,61 @@
+//
+//  GeomUtils.cpp
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2016-03-12.
+//  Copyright © 2016 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <cmath>
+
+#include "GeomUtils.h"
+
+const float ROUND_TOLERANCE = 1e-3f;
+
+bool GeomUtils::intersects(const cv::Rect &rect0, const cv::Rect &rect1)
+{
+    return
+        rect0.x                < rect1.x + rect1.width  &&
+        rect0.x + rect0.width  > rect1.x                &&
+        rect0.y                < rect1.y + rect1.height &&
+        rect0.y + rect0.height > rect1.y;
+}
+
+cv::Rect2f GeomUtils::scale(const cv::Rect &rect, double factor)
+{
+    return cv::Rect2f((float)(rect.x * factor), (float)(rect.y * factor), (float)(rect.width * factor), (float)(rect.height * factor));
+}
+
+cv::Rect GeomUtils::roundOutward(const cv::Rect2f &rect)
+{
+    int left = (int)std::floor(rect.x + ROUND_TOLERANCE);
+    int top = (int)std::floor(rect.y + ROUND_TOLERANCE);
+    int right = (int)std::ceil(rect.x + rect.width - ROUND_TOLERANCE);
+    int bottom = (int)std::ceil(rect.y + rect.height - ROUND_TOLERANCE);
+    return cv::Rect(left, top, right - left, bottom - top);
+}
@@ -0,0 +1,58 @@
+//
+//  GeomUtils.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2016-03-12.
+//  Copyright © 2016 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef GEOM_UTILS_H
+#define GEOM_UTILS_H
+
+#include <opencv2/core.hpp>
+
+namespace GeomUtils {
+    bool intersects(const cv::Rect &rect0, const cv::Rect &rect1);
+    
+    /**
+     * Scale a rectangle without rounding. For example, a factor of
+     * 1.0 / resizeFactor maps a rectangle in a resized image to the
+     * original image. Coordinates refer to pixel edges, so pixel i spans
+     * [i, i + 1) and the mapping is the same for every corner.
+     */
+    cv::Rect2f scale(const cv::Rect &rect, double factor);
+    
+    /**
+     * Round a rectangle outward to whole pixels, so that it covers the
+     * original. Edges within a small tolerance of a whole pixel are
+     * rounded to it, so floating-point error does not grow the rectangle.
+     */
+    cv::Rect roundOutward(const cv::Rect2f &rect);
+}
+
+#endif // !GEOM_UTILS_H
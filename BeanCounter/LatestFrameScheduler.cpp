@@ -0,0 +1,164 @@
+//
+//  LatestFrameScheduler.cpp
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "LatestFrameScheduler.h"
+
+// One buffer is pending, one is being processed, and one is being filled.
+const size_t POOL_MAX_NUM_IDLE_BUFFERS = 3;
+
+LatestFrameScheduler::LatestFrameScheduler(const Processor &processor)
+: processor(processor)
+, framePool(POOL_MAX_NUM_IDLE_BUFFERS)
+, pendingFrameID(0ull)
+, processing(false)
+, stopping(false)
+, nextFrameID(0ull)
+{
+    resetStats();
+    worker = std::thread(&LatestFrameScheduler::run, this);
+}
+
+LatestFrameScheduler::~LatestFrameScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pendingFrame.reset();
+    }
+    framePosted.notify_all();
+    frameProcessed.notify_all();
+    worker.join();
+}
+
+uint64_t LatestFrameScheduler::post(const cv::Mat &frame) {
+    
+    // Copy the frame outside the lock, so that the worker is not blocked.
+    FramePool::Lease frameCopy = framePool.leaseCopy(frame);
+    Clock::time_point postTime = Clock::now();
+    
+    uint64_t frameID;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frameID = nextFrameID++;
+        stats.numPostedFrames++;
+        if (pendingFrame) {
+            // The previous frame is stale. Drop it.
+            stats.numDroppedFrames++;
+        }
+        pendingFrame = frameCopy;
+        pendingFrameID = frameID;
+        pendingFramePostTime = postTime;
+    }
+    framePosted.notify_one();
+    
+    return frameID;
+}
+
+void LatestFrameScheduler::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    frameProcessed.wait(lock, [this] {
+        return stopping || (!pendingFrame && !processing);
+    });
+}
+
+LatestFrameScheduler::Stats LatestFrameScheduler::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    if (stats.numProcessedFrames > 0) {
+        result.meanLatency = totalLatency / stats.numProcessedFrames;
+    }
+    return result;
+}
+
+void LatestFrameScheduler::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.numPostedFrames = 0ull;
+    stats.numProcessedFrames = 0ull;
+    stats.numDroppedFrames = 0ull;
+    stats.numFailedFrames = 0ull;
+    stats.meanLatency = 0.0;
+    stats.maxLatency = 0.0;
+    totalLatency = 0.0;
+}
+
+void LatestFrameScheduler::run() {
+    
+    while (true) {
+        
+        FramePool::Lease frame;
+        uint64_t frameID;
+        Clock::time_point postTime;
+        
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            framePosted.wait(lock, [this] {
+                return stopping || pendingFrame;
+            });
+            if (stopping) {
+                return;
+            }
+            frame.swap(pendingFrame);
+            frameID = pendingFrameID;
+            postTime = pendingFramePostTime;
+            processing = true;
+        }
+        
+        // A frame that fails is counted and skipped, so that it does not
+        // stop the worker or leave the scheduler busy.
+        bool success;
+        try {
+            processor(*frame, frameID);
+            success = true;
+        } catch (const std::exception &) {
+            success = false;
+        }
+        
+        // Return the buffer to the pool before the next frame is taken.
+        frame.reset();
+        
+        double latency = std::chrono::duration<double>(Clock::now() - postTime).count();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            processing = false;
+            stats.numProcessedFrames++;
+            if (!success) {
+                stats.numFailedFrames++;
+            }
+            totalLatency += latency;
+            if (latency > stats.maxLatency) {
+                stats.maxLatency = latency;
+            }
+        }
+        frameProcessed.notify_all();
+    }
+}
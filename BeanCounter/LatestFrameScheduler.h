@@ -0,0 +1,137 @@
+//
+//  LatestFrameScheduler.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef LATEST_FRAME_SCHEDULER_H
+#define LATEST_FRAME_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <opencv2/core.hpp>
+
+#include "FramePool.h"
+
+/**
+ * A scheduler that decouples a frame source, such as a camera callback,
+ * from a slower processing stage on a worker thread.
+ * It holds at most one pending frame. Posting a frame replaces any frame
+ * that has not yet been processed, so the worker always processes the
+ * newest frame and the latency does not grow when processing is slow.
+ * It has no dependencies on iOS, so it can also be driven from files.
+ */
+class LatestFrameScheduler
+{
+public:
+    /**
+     * A function that is called on the worker thread to process a copy
+     * of a posted frame. The copy may be modified.
+     */
+    typedef std::function<void(cv::Mat &frame, uint64_t frameID)> Processor;
+    
+    struct Stats {
+        uint64_t numPostedFrames;
+        uint64_t numProcessedFrames;
+        
+        /**
+         * The number of frames that were replaced before being processed.
+         */
+        uint64_t numDroppedFrames;
+        
+        /**
+         * The number of processed frames whose processor threw an
+         * exception.
+         */
+        uint64_t numFailedFrames;
+        
+        /**
+         * The time from posting to the end of processing, in seconds.
+         */
+        double meanLatency;
+        double maxLatency;
+    };
+    
+    LatestFrameScheduler(const Processor &processor);
+    
+    /**
+     * Discard any pending frame, wait for the current frame to be
+     * processed, then stop the worker thread.
+     */
+    ~LatestFrameScheduler();
+    
+    /**
+     * Copy a frame and make it the pending frame, replacing any other.
+     * Returns the frame's ID, which increases with each post.
+     */
+    uint64_t post(const cv::Mat &frame);
+    
+    /**
+     * Block until the pending frame, if any, has been processed, or until
+     * the scheduler starts to stop.
+     */
+    void waitUntilIdle();
+    
+    Stats getStats() const;
+    void resetStats();
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    void run();
+    
+    Processor processor;
+    FramePool framePool;
+    
+    /**
+     * A mutex that guards all of the following members.
+     */
+    mutable std::mutex mutex;
+    std::condition_variable framePosted;
+    std::condition_variable frameProcessed;
+    
+    FramePool::Lease pendingFrame;
+    uint64_t pendingFrameID;
+    Clock::time_point pendingFramePostTime;
+    bool processing;
+    bool stopping;
+    
+    uint64_t nextFrameID;
+    Stats stats;
+    double totalLatency;
+    
+    std::thread worker;
+};
+
+#endif // !LATEST_FRAME_SCHEDULER_H
@@ -0,0 +1,133 @@
+//
+//  ResizeFactorController.cpp
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "ResizeFactorController.h"
+
+// The weight of each new measurement in the smoothed latency.
+const double LATENCY_SMOOTHING_WEIGHT = 0.2;
+
+// The tolerance band around the target latency, as fractions of it.
+// Above the band, the factor goes down. Below the band, it goes up.
+const double LATENCY_BAND_UPPER = 1.1;
+const double LATENCY_BAND_LOWER = 0.7;
+
+// The number of consecutive frames outside the band before an adjustment.
+const int ADJUST_MIN_NUM_FRAMES_OUTSIDE_BAND = 5;
+
+// The largest change in the factor per adjustment, as a ratio.
+const double ADJUST_MAX_RATIO = 1.25;
+
+// The factor is a multiple of this quantum, so that it settles on a few
+// distinct sizes of resized images.
+const double RESIZE_FACTOR_QUANTUM = 1.0 / 32.0;
+
+static double quantizeResizeFactor(double resizeFactor) {
+    return std::round(resizeFactor / RESIZE_FACTOR_QUANTUM) * RESIZE_FACTOR_QUANTUM;
+}
+
+ResizeFactorController::ResizeFactorController(double targetLatency, double initialResizeFactor, double minResizeFactor, double maxResizeFactor)
+: targetLatency(targetLatency)
+, minResizeFactor(minResizeFactor)
+, maxResizeFactor(maxResizeFactor)
+, numFramesOutsideBand(0)
+, resizeFactor(std::min(std::max(initialResizeFactor, minResizeFactor), maxResizeFactor))
+, smoothedLatency(targetLatency)
+, numAdjustments(0ull)
+{
+}
+
+double ResizeFactorController::beginFrame() {
+    frameStartTime = Clock::now();
+    return resizeFactor;
+}
+
+void ResizeFactorController::endFrame() {
+    update(std::chrono::duration<double>(Clock::now() - frameStartTime).count());
+}
+
+void ResizeFactorController::update(double latency) {
+    
+    double latencyEstimate = smoothedLatency + LATENCY_SMOOTHING_WEIGHT * (latency - smoothedLatency);
+    smoothedLatency = latencyEstimate;
+    
+    // Apply hysteresis. Only adjust after several frames outside the band.
+    if (latencyEstimate > LATENCY_BAND_UPPER * targetLatency || latencyEstimate < LATENCY_BAND_LOWER * targetLatency) {
+        numFramesOutsideBand++;
+    } else {
+        numFramesOutsideBand = 0;
+    }
+    if (numFramesOutsideBand < ADJUST_MIN_NUM_FRAMES_OUTSIDE_BAND) {
+        return;
+    }
+    numFramesOutsideBand = 0;
+    
+    // Latency is roughly proportional to the resized area, so scale the
+    // factor by the square root of the latency ratio, within limits.
+    double ratio = std::sqrt(targetLatency / std::max(latencyEstimate, 1e-6));
+    ratio = std::min(std::max(ratio, 1.0 / ADJUST_MAX_RATIO), ADJUST_MAX_RATIO);
+    
+    double oldResizeFactor = resizeFactor;
+    double newResizeFactor = quantizeResizeFactor(oldResizeFactor * ratio);
+    newResizeFactor = std::min(std::max(newResizeFactor, minResizeFactor), maxResizeFactor);
+    if (newResizeFactor == oldResizeFactor) {
+        // The factor is at a limit, or the change is below the quantum.
+        return;
+    }
+    
+    resizeFactor = newResizeFactor;
+    numAdjustments++;
+    
+    // Predict the latency at the new factor, so that the next adjustment
+    // does not overshoot while the smoothed latency catches up.
+    double areaRatio = (newResizeFactor * newResizeFactor) / (oldResizeFactor * oldResizeFactor);
+    smoothedLatency = latencyEstimate * areaRatio;
+}
+
+double ResizeFactorController::getTargetLatency() const {
+    return targetLatency;
+}
+
+double ResizeFactorController::getResizeFactor() const {
+    return resizeFactor;
+}
+
+double ResizeFactorController::getSmoothedLatency() const {
+    return smoothedLatency;
+}
+
+uint64_t ResizeFactorController::getNumAdjustments() const {
+    return numAdjustments;
+}
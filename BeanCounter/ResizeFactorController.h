@@ -0,0 +1,102 @@
+//
+//  ResizeFactorController.h
+//  BeanCounter
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef RESIZE_FACTOR_CONTROLLER_H
+#define RESIZE_FACTOR_CONTROLLER_H
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * A closed-loop controller that chooses a detector's resize factor for
+ * each frame, based on the measured detection latency and a target
+ * budget.
+ * Detection cost is roughly proportional to the resized area, so the
+ * factor is scaled by the square root of the ratio of the target latency
+ * to the smoothed latency. It only changes after the latency has been
+ * outside a tolerance band for several consecutive frames, and it moves
+ * in fixed quanta, so it does not oscillate between similar values.
+ */
+class ResizeFactorController
+{
+public:
+    /**
+     * Construct a controller with a target latency, in seconds, and an
+     * initial resize factor that is clamped to the given range.
+     */
+    ResizeFactorController(double targetLatency, double initialResizeFactor, double minResizeFactor = 0.25, double maxResizeFactor = 1.0);
+    
+    /**
+     * Start timing a frame and get the resize factor to use for it.
+     */
+    double beginFrame();
+    
+    /**
+     * Stop timing the frame and update the resize factor.
+     * If the frame's cost is not representative of the resize factor,
+     * for example because only part of it was searched, do not call this.
+     * The next call to beginFrame starts a new timing.
+     */
+    void endFrame();
+    
+    /**
+     * Update the resize factor with a latency that was measured by the
+     * caller, in seconds.
+     */
+    void update(double latency);
+    
+    double getTargetLatency() const;
+    
+    // The following getters are safe to call from any thread, for
+    // example, to display instrumentation.
+    
+    double getResizeFactor() const;
+    double getSmoothedLatency() const;
+    uint64_t getNumAdjustments() const;
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    double targetLatency;
+    double minResizeFactor;
+    double maxResizeFactor;
+    
+    Clock::time_point frameStartTime;
+    int numFramesOutsideBand;
+    
+    std::atomic<double> resizeFactor;
+    std::atomic<double> smoothedLatency;
+    std::atomic<uint64_t> numAdjustments;
+};
+
+#endif // !RESIZE_FACTOR_CONTROLLER_H
@@ -0,0 +1,307 @@
+//
+//  SourceCache.cpp
+//  CoolPig
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/imgproc.hpp>
+
+#ifdef WITH_OPENCV_CONTRIB
+#include <opencv2/xphoto.hpp>
+#endif
+
+#include "SourceCache.h"
+
+// The version of the entries' format and of the preprocessing.
+// Increment it whenever either changes, so that old entries are ignored.
+const uint32_t ENTRY_VERSION = 2;
+
+const char ENTRY_MAGIC[4] = {'C', 'P', 'S', 'C'};
+
+#ifdef WITH_OPENCV_CONTRIB
+const double WHITE_BALANCE_SATURATION_THRESHOLD = 0.9;
+#endif
+
+/**
+ * The header of an entry, which is followed by the image's rows without
+ * padding. Its size is a multiple of 16 bytes, so the rows are aligned.
+ * The payload hash covers the rows, so a corrupt entry is ignored.
+ */
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t contentHash;
+    uint64_t payloadHash;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    uint32_t reserved[3];
+};
+static_assert(sizeof(EntryHeader) % 16 == 0, "The entries' rows must be aligned");
+
+/**
+ * Hash data using 64-bit FNV-1a.
+ */
+static uint64_t hash(const void *data, size_t size, uint64_t h = 14695981039346656037ULL) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+SourceCache::SourceCache(const std::string &directory)
+: directory(directory)
+, numHits(0)
+, numMisses(0)
+{
+}
+
+SourceCache::~SourceCache() {
+    clear();
+}
+
+bool SourceCache::get(const void *encodedData, size_t encodedSize, const Decoder &decode, cv::Mat &image) {
+    
+    uint64_t contentHash = hash(encodedData, encodedSize);
+    std::string path = getPath(contentHash);
+    
+    // Check whether the entry is already loaded.
+    std::map<std::string, Mapping>::const_iterator mappingIt = mappings.find(path);
+    if (mappingIt != mappings.end()) {
+        numHits++;
+        image = mappingIt->second.image;
+        return true;
+    }
+    std::map<std::string, cv::Mat>::const_iterator unmappedIt = unmappedImages.find(path);
+    if (unmappedIt != unmappedImages.end()) {
+        numHits++;
+        image = unmappedIt->second;
+        return true;
+    }
+    
+    // Try to load the entry from disk.
+    Mapping mapping;
+    if (load(path, contentHash, mapping)) {
+        numHits++;
+        mappings[path] = mapping;
+        image = mapping.image;
+        return true;
+    }
+    
+    // Decode and preprocess the source.
+    numMisses++;
+    cv::Mat decodedImage;
+    if (!decode(decodedImage) || decodedImage.empty()) {
+        return false;
+    }
+    cv::Mat preprocessedImage;
+    preprocess(decodedImage, preprocessedImage);
+    
+    // Write the entry, then map it so that it is shared with the next
+    // lookup. If either step fails, keep the image in memory instead.
+    if (store(path, contentHash, preprocessedImage) && load(path, contentHash, mapping)) {
+        mappings[path] = mapping;
+        image = mapping.image;
+    } else {
+        unmappedImages[path] = preprocessedImage;
+        image = preprocessedImage;
+    }
+    return true;
+}
+
+void SourceCache::clear() {
+    for (std::pair<const std::string, Mapping> &entry : mappings) {
+        Mapping &mapping = entry.second;
+        mapping.image.release();
+        munmap(mapping.address, mapping.length);
+    }
+    mappings.clear();
+    unmappedImages.clear();
+}
+
+void SourceCache::preprocess(const cv::Mat &src, cv::Mat &dst) {
+    switch (src.type()) {
+        case CV_8UC1:
+            // The cv::Mat is in grayscale format.
+            // Convert it to RGB format.
+            cv::cvtColor(src, dst, cv::COLOR_GRAY2RGB);
+            break;
+        case CV_8UC4: {
+            // The cv::Mat is in RGBA format.
+            // Convert it to RGB format.
+            cv::cvtColor(src, dst, cv::COLOR_RGBA2RGB);
+#ifdef WITH_OPENCV_CONTRIB
+            // Adjust the white balance.
+            cv::Ptr<cv::xphoto::GrayworldWB> whiteBalancer = cv::xphoto::createGrayworldWB();
+            whiteBalancer->setSaturationThreshold(WHITE_BALANCE_SATURATION_THRESHOLD);
+            whiteBalancer->balanceWhite(dst, dst);
+#endif
+            break;
+        }
+        case CV_8UC3: {
+            // The cv::Mat is in RGB format.
+#ifdef WITH_OPENCV_CONTRIB
+            // Adjust the white balance.
+            cv::Ptr<cv::xphoto::GrayworldWB> whiteBalancer = cv::xphoto::createGrayworldWB();
+            whiteBalancer->setSaturationThreshold(WHITE_BALANCE_SATURATION_THRESHOLD);
+            whiteBalancer->balanceWhite(src, dst);
+#else
+            src.copyTo(dst);
+#endif
+            break;
+        }
+        default:
+            src.copyTo(dst);
+            break;
+    }
+}
+
+size_t SourceCache::getNumHits() const {
+    return numHits;
+}
+
+size_t SourceCache::getNumMisses() const {
+    return numMisses;
+}
+
+std::string SourceCache::getPath(uint64_t contentHash) const {
+    
+    // Hash the preprocessing parameters separately from the content, so
+    // that the entries for one source are easy to recognize.
+#ifdef WITH_OPENCV_CONTRIB
+    double params[] = {1.0, WHITE_BALANCE_SATURATION_THRESHOLD};
+#else
+    double params[] = {0.0, 0.0};
+#endif
+    uint64_t paramsHash = hash(params, sizeof(params), hash(&ENTRY_VERSION, sizeof(ENTRY_VERSION)));
+    
+    char filename[64];
+    snprintf(filename, sizeof(filename), "%016llx-%016llx.raw", (unsigned long long)contentHash, (unsigned long long)paramsHash);
+    return directory + "/" + filename;
+}
+
+bool SourceCache::load(const std::string &path, uint64_t contentHash, Mapping &mapping) const {
+    
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(EntryHeader)) {
+        close(fd);
+        return false;
+    }
+    
+    // Map the entry privately, so that changes to the image are copied
+    // on write and do not reach the file.
+    size_t length = (size_t)fileStat.st_size;
+    void *address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    
+    // Validate the header against the source and the file's size.
+    const EntryHeader *header = (const EntryHeader *)address;
+    bool valid =
+        memcmp(header->magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0 &&
+        header->version == ENTRY_VERSION &&
+        header->contentHash == contentHash &&
+        header->rows > 0 && header->cols > 0 &&
+        CV_MAT_DEPTH(header->type) == CV_8U;
+    if (valid) {
+        size_t dataSize = (size_t)header->rows * header->cols * CV_ELEM_SIZE(header->type);
+        valid = (length == sizeof(EntryHeader) + dataSize) &&
+            hash((const uint8_t *)address + sizeof(EntryHeader), dataSize) == header->payloadHash;
+    }
+    if (!valid) {
+        munmap(address, length);
+        return false;
+    }
+    
+    mapping.address = address;
+    mapping.length = length;
+    mapping.image = cv::Mat(header->rows, header->cols, header->type, (uint8_t *)address + sizeof(EntryHeader));
+    return true;
+}
+
+bool SourceCache::store(const std::string &path, uint64_t contentHash, const cv::Mat &image) const {
+    
+    EntryHeader header;
+    memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.version = ENTRY_VERSION;
+    header.contentHash = contentHash;
+    header.rows = image.rows;
+    header.cols = image.cols;
+    header.type = image.type();
+    memset(header.reserved, 0, sizeof(header.reserved));
+    
+    // Hash the rows, without their padding.
+    size_t rowSize = image.cols * image.elemSize();
+    header.payloadHash = hash(NULL, 0);
+    for (int y = 0; y < image.rows; y++) {
+        header.payloadHash = hash(image.ptr(y), rowSize, header.payloadHash);
+    }
+    
+    // Write to a temporary file with a unique name, then rename it, so
+    // that a concurrent or interrupted run never sees a partial entry.
+    std::string tempPath = path + ".XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd < 0) {
+        return false;
+    }
+    FILE *file = fdopen(fd, "wb");
+    if (file == NULL) {
+        close(fd);
+        remove(tempPath.c_str());
+        return false;
+    }
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int y = 0; success && y < image.rows; y++) {
+        success = fwrite(image.ptr(y), rowSize, 1, file) == 1;
+    }
+    success = (fclose(file) == 0) && success;
+    if (success) {
+        success = rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+    if (!success) {
+        remove(tempPath.c_str());
+    }
+    return success;
+}
@@ -0,0 +1,125 @@
+//
+//  SourceCache.h
+//  CoolPig
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef SOURCE_CACHE_H
+#define SOURCE_CACHE_H
+
+#include <functional>
+#include <stdint.h>
+#include <map>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+/**
+ * A cache of preprocessed source images, persisted in a directory.
+ * Sources are converted to RGB and, if OpenCV's extra modules are
+ * available, white balanced.
+ * Entries are addressed by a hash of the source's encoded data and by
+ * the preprocessing parameters, so an entry is found again on later runs
+ * and a change to either yields a new entry. Entries are stored as raw
+ * pixels after a small header, and are memory-mapped when they are
+ * loaded, so a hit needs no decoding, balancing, or copying.
+ */
+class SourceCache
+{
+public:
+    /**
+     * A function that decodes the source into an 8-bit grayscale, RGB,
+     * or RGBA image. It is only called if the source is not cached.
+     */
+    typedef std::function<bool(cv::Mat &image)> Decoder;
+    
+    /**
+     * Construct a cache that persists entries in the given directory,
+     * which must already exist.
+     */
+    SourceCache(const std::string &directory);
+    
+    /**
+     * Unmap all of the loaded entries.
+     */
+    ~SourceCache();
+    
+    /**
+     * Get the preprocessed version of a source, given its encoded data.
+     * If the source is not cached, it is decoded and preprocessed, and
+     * then an entry is written for later runs. If the entry cannot be
+     * written, the preprocessed image is still returned.
+     * The image is valid until clear() is called or the cache is
+     * destroyed. It may be modified without affecting the entry.
+     * Returns false if the source cannot be decoded.
+     */
+    bool get(const void *encodedData, size_t encodedSize, const Decoder &decode, cv::Mat &image);
+    
+    /**
+     * Unmap all of the loaded entries. The entries remain on disk.
+     */
+    void clear();
+    
+    /**
+     * Convert an image to RGB and, if OpenCV's extra modules are
+     * available, white balance it.
+     */
+    static void preprocess(const cv::Mat &src, cv::Mat &dst);
+    
+    size_t getNumHits() const;
+    size_t getNumMisses() const;
+    
+private:
+    struct Mapping {
+        void *address;
+        size_t length;
+        cv::Mat image;
+    };
+    
+    std::string getPath(uint64_t contentHash) const;
+    bool load(const std::string &path, uint64_t contentHash, Mapping &mapping) const;
+    bool store(const std::string &path, uint64_t contentHash, const cv::Mat &image) const;
+    
+    std::string directory;
+    
+    /**
+     * The loaded entries, keyed by path.
+     */
+    std::map<std::string, Mapping> mappings;
+    
+    /**
+     * Preprocessed images whose entries could not be written or mapped.
+     */
+    std::map<std::string, cv::Mat> unmappedImages;
+    
+    size_t numHits;
+    size_t numMisses;
+};
+
+#endif // !SOURCE_CACHE_H
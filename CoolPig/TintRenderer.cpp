@@ -0,0 +1,164 @@
+//
+//  TintRenderer.cpp
+//  CoolPig
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <algorithm>
+#include <stdint.h>
+
+#include "TintRenderer.h"
+
+// Gains are represented in fixed point, with this many fractional bits.
+// A 16-bit gain times an 8-bit value fits in 32 bits, so the kernel
+// needs no wider arithmetic.
+const int TINT_GAIN_NUM_FRACTIONAL_BITS = 12;
+const uint32_t TINT_GAIN_ONE = 1u << TINT_GAIN_NUM_FRACTIONAL_BITS;
+const uint32_t TINT_GAIN_ROUNDING = TINT_GAIN_ONE >> 1;
+const uint32_t TINT_GAIN_MAX = UINT16_MAX;
+
+/**
+ * A parallel loop body that renders a range of variants.
+ */
+class VariantRenderer : public cv::ParallelLoopBody
+{
+public:
+    VariantRenderer(const cv::Mat &src, const std::vector<cv::Scalar> &gains, std::vector<cv::Mat> &variants)
+    : src(src)
+    , gains(gains)
+    , variants(variants)
+    {
+    }
+    
+    void operator()(const cv::Range &range) const {
+        for (int i = range.start; i < range.end; i++) {
+            TintRenderer::tint(src, gains[i], variants[i]);
+        }
+    }
+    
+private:
+    const cv::Mat &src;
+    const std::vector<cv::Scalar> &gains;
+    std::vector<cv::Mat> &variants;
+};
+
+TintRenderer::TintRenderer()
+: numVariants(0)
+, variantsPerSecond(0.0)
+, rng((uint64)cv::getTickCount())
+{
+}
+
+void TintRenderer::tint(const cv::Mat &src, const cv::Scalar &gains, cv::Mat &dst) {
+    
+    CV_Assert(src.depth() == CV_8U && src.channels() <= 4);
+    
+    int numChannels = src.channels();
+    int rowLength = src.cols * numChannels;
+    
+    // Convert the gains to fixed point.
+    uint16_t fixedGains[4];
+    for (int c = 0; c < numChannels; c++) {
+        double gain = std::max(0.0, std::min(gains[c], getMaxGain()));
+        fixedGains[c] = (uint16_t)cvRound(gain * TINT_GAIN_ONE);
+    }
+    
+    // Repeat the gains across a whole row, so that the inner loop has no
+    // dependency on the channel and the compiler can vectorize it.
+    cv::AutoBuffer<uint16_t> rowGains(rowLength);
+    for (int i = 0; i < rowLength; i++) {
+        rowGains[i] = fixedGains[i % numChannels];
+    }
+    const uint16_t *g = rowGains;
+    
+    dst.create(src.size(), src.type());
+    
+    for (int y = 0; y < src.rows; y++) {
+        const uint8_t *s = src.ptr<uint8_t>(y);
+        uint8_t *d = dst.ptr<uint8_t>(y);
+        for (int i = 0; i < rowLength; i++) {
+            uint32_t value = ((uint32_t)s[i] * g[i] + TINT_GAIN_ROUNDING) >> TINT_GAIN_NUM_FRACTIONAL_BITS;
+            d[i] = (uint8_t)std::min(value, (uint32_t)UINT8_MAX);
+        }
+    }
+}
+
+double TintRenderer::getMaxGain() {
+    return (double)TINT_GAIN_MAX / TINT_GAIN_ONE;
+}
+
+size_t TintRenderer::render(const cv::Mat &src, const std::vector<cv::Scalar> &gains) {
+    
+    int64 startTicks = cv::getTickCount();
+    
+    // Keep any extra buffers from earlier, larger batches, so that they
+    // can be reused later.
+    numVariants = gains.size();
+    if (variants.size() < numVariants) {
+        variants.resize(numVariants);
+    }
+    variantGains = gains;
+    
+    // Render the variants in parallel, one per task.
+    cv::parallel_for_(cv::Range(0, (int)numVariants), VariantRenderer(src, variantGains, variants));
+    
+    double seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+    variantsPerSecond = (seconds > 0.0) ? numVariants / seconds : 0.0;
+    
+    return numVariants;
+}
+
+size_t TintRenderer::renderRandom(const cv::Mat &src, size_t numVariants, const cv::Scalar &minGains, const cv::Scalar &maxGains) {
+    std::vector<cv::Scalar> gains(numVariants);
+    for (cv::Scalar &gain : gains) {
+        for (int c = 0; c < 4; c++) {
+            gain[c] = rng.uniform(minGains[c], maxGains[c]);
+        }
+    }
+    return render(src, gains);
+}
+
+size_t TintRenderer::getNumVariants() const {
+    return numVariants;
+}
+
+const cv::Mat &TintRenderer::getVariant(size_t i) const {
+    CV_Assert(i < numVariants);
+    return variants[i];
+}
+
+const cv::Scalar &TintRenderer::getVariantGains(size_t i) const {
+    CV_Assert(i < numVariants);
+    return variantGains[i];
+}
+
+double TintRenderer::getVariantsPerSecond() const {
+    return variantsPerSecond;
+}
@@ -0,0 +1,102 @@
+//
+//  TintRenderer.h
+//  CoolPig
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef TINT_RENDERER_H
+#define TINT_RENDERER_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ * A renderer that tints 8-bit images by per-channel gains, and renders
+ * batches of tinted variants of one source image in parallel.
+ * Gains are applied in fixed point, in one pass with saturation. The
+ * result is within one level of cv::multiply with the same gains.
+ * The variants' buffers are reused from batch to batch, so a renderer
+ * should only be used from one thread at a time.
+ */
+class TintRenderer
+{
+public:
+    TintRenderer();
+    
+    /**
+     * Multiply each channel of an 8-bit image by the corresponding gain.
+     * Gains are clamped to the range [0, getMaxGain()].
+     * The destination may be the same as the source.
+     */
+    static void tint(const cv::Mat &src, const cv::Scalar &gains, cv::Mat &dst);
+    
+    /**
+     * Get the largest gain that can be represented in fixed point.
+     */
+    static double getMaxGain();
+    
+    /**
+     * Render a variant of the source image for each of the given gains.
+     * Returns the number of variants.
+     */
+    size_t render(const cv::Mat &src, const std::vector<cv::Scalar> &gains);
+    
+    /**
+     * Render numVariants variants of the source image, with gains chosen
+     * uniformly at random between minGains and maxGains.
+     * Returns the number of variants.
+     */
+    size_t renderRandom(const cv::Mat &src, size_t numVariants, const cv::Scalar &minGains, const cv::Scalar &maxGains);
+    
+    size_t getNumVariants() const;
+    
+    /**
+     * Get a variant from the last batch. Its buffer is reused by the next
+     * batch, so it must be copied if it is needed for longer.
+     */
+    const cv::Mat &getVariant(size_t i) const;
+    const cv::Scalar &getVariantGains(size_t i) const;
+    
+    /**
+     * Get the throughput of the last batch, in variants per second.
+     */
+    double getVariantsPerSecond() const;
+    
+private:
+    std::vector<cv::Mat> variants;
+    std::vector<cv::Scalar> variantGains;
+    size_t numVariants;
+    
+    double variantsPerSecond;
+    
+    cv::RNG rng;
+};
+
+#endif // !TINT_RENDERER_H
@@ -33,21 +33,26 @@
 
 #import <opencv2/core.hpp>
 #import <opencv2/imgcodecs/ios.h>
-#import <opencv2/imgproc.hpp>
-
-#ifdef WITH_OPENCV_CONTRIB
-#import <opencv2/xphoto.hpp>
-#endif
 
+#import "SourceCache.h"
+#import "TintRenderer.h"
 #import "ViewController.h"
 
 
-#define RAND_0_1() ((double)arc4random() / 0x100000000)
+// Random tints are chosen between these gains, in RGB order.
+const cv::Scalar TINT_MIN_GAINS(0.5, 0.6, 0.4);
+const cv::Scalar TINT_MAX_GAINS(1.5, 1.4, 1.6);
+
+// Tinted variants are rendered in batches of this size, and shown one
+// at a time.
+const size_t TINT_NUM_VARIANTS_PER_BATCH = 8;
 
 
 @interface ViewController () {
+    SourceCache *sourceCache;
     cv::Mat originalMat;
-    cv::Mat updatedMat;
+    TintRenderer tintRenderer;
+    size_t nextVariantIndex;
 }
 
 @property IBOutlet UIImageView *imageView;
@@ -63,41 +68,29 @@
 - (void)viewDidLoad {
     [super viewDidLoad];
     
-    // Load a UIImage from a resource file.
-    UIImage *originalImage = [UIImage imageNamed:@"Piggy.png"];
+    // Create a cache of preprocessed sources, in the app's caches directory.
+    // Entries persist across runs, so a source is only decoded and
+    // white balanced once.
+    NSString *cachesPath = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+    NSString *sourceCachePath = [cachesPath stringByAppendingPathComponent:@"PreprocessedSources"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:sourceCachePath withIntermediateDirectories:YES attributes:nil error:nil];
+    sourceCache = new SourceCache([sourceCachePath UTF8String]);
     
-    // Convert the UIImage to a cv::Mat.
-    UIImageToMat(originalImage, originalMat);
+    // Read the encoded data from a resource file.
+    NSString *originalImagePath = [[NSBundle mainBundle] pathForResource:@"Piggy" ofType:@"png"];
+    NSData *originalImageData = [NSData dataWithContentsOfFile:originalImagePath options:NSDataReadingMappedIfSafe error:nil];
     
-    switch (originalMat.type()) {
-        case CV_8UC1:
-            // The cv::Mat is in grayscale format.
-            // Convert it to RGB format.
-            cv::cvtColor(originalMat, originalMat, cv::COLOR_GRAY2RGB);
-            break;
-        case CV_8UC4: {
-            // The cv::Mat is in RGBA format.
-            // Convert it to RGB format.
-            cv::cvtColor(originalMat, originalMat, cv::COLOR_RGBA2RGB);
-#ifdef WITH_OPENCV_CONTRIB
-            // Adjust the white balance.
-            cv::Ptr<cv::xphoto::GrayworldWB> whiteBalancer = cv::xphoto::createGrayworldWB();
-            whiteBalancer->balanceWhite(originalMat, originalMat);
-#endif
-            break;
-        }
-        case CV_8UC3: {
-            // The cv::Mat is in RGB format.
-#ifdef WITH_OPENCV_CONTRIB
-            // Adjust the white balance.
-            cv::Ptr<cv::xphoto::GrayworldWB> whiteBalancer = cv::xphoto::createGrayworldWB();
-            whiteBalancer->balanceWhite(originalMat, originalMat);
-#endif
-            break;
+    // Get the preprocessed cv::Mat from the cache.
+    // If it is not cached, convert the data to a UIImage and then to a
+    // cv::Mat, which the cache converts to RGB format and white balances.
+    sourceCache->get(originalImageData.bytes, originalImageData.length, [originalImageData](cv::Mat &image) {
+        UIImage *originalImage = [UIImage imageWithData:originalImageData];
+        if (originalImage == nil) {
+            return false;
         }
-        default:
-            break;
-    }
+        UIImageToMat(originalImage, image);
+        return true;
+    }, originalMat);
     
     // Call an update method every 2 seconds.
     self.timer = [NSTimer scheduledTimerWithTimeInterval:2.0 target:self selector:@selector(updateImage) userInfo:nil repeats:YES];
@@ -119,18 +112,28 @@
     }];
 }
 
+- (void)dealloc {
+    // Release the cv::Mat before unmapping the data that it refers to.
+    originalMat.release();
+    if (sourceCache != NULL) {
+        delete sourceCache;
+        sourceCache = NULL;
+    }
+}
+
 - (void)updateImage {
-    // Generate a random color.
-    double r = 0.5 + RAND_0_1() * 1.0;
-    double g = 0.6 + RAND_0_1() * 0.8;
-    double b = 0.4 + RAND_0_1() * 1.2;
-    cv::Scalar randomColor(r, g, b);
-    
-    // Create an updated, tinted cv::Mat by multiplying the original cv::Mat and the random color.
-    cv::multiply(originalMat, randomColor, updatedMat);
+    if (nextVariantIndex >= tintRenderer.getNumVariants()) {
+        // Render a new batch of variants, each tinted by multiplying the
+        // original cv::Mat and a random color.
+        tintRenderer.renderRandom(originalMat, TINT_NUM_VARIANTS_PER_BATCH, TINT_MIN_GAINS, TINT_MAX_GAINS);
+        nextVariantIndex = 0;
+    }
     
-    // Convert the updated cv::Mat to a UIImage and display it in the UIImageView.
-    self.imageView.image = MatToUIImage(updatedMat);
+    // Convert the next variant to a UIImage and display it in the UIImageView.
+    // The UIImage has its own copy of the data, so the variant's buffer
+    // can be reused by the next batch.
+    self.imageView.image = MatToUIImage(tintRenderer.getVariant(nextVariantIndex));
+    nextVariantIndex++;
 }
 
 @end
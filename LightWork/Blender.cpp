@@ -0,0 +1,241 @@
+//
+//  Blender.cpp
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <opencv2/imgproc.hpp>
+
+#include "Blender.h"
+
+// The kernels treat every channel alike, so they operate on rows of
+// bytes. They are written as simple, branch-free loops over 16-bit
+// intermediates, which the compiler vectorizes for NEON or SSE.
+
+/**
+ * Divide a product of two 8-bit values by 255, rounding to the nearest
+ * integer. This is exact for every x in [0, 255 * 255].
+ */
+static inline uint16_t div255(uint16_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static void blendAverageRow(uchar *dst, const uchar *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        // Halve the sum, rounding half to even as cv::addWeighted does.
+        uint16_t sum = dst[i] + src[i];
+        uint16_t half = sum >> 1;
+        dst[i] = (uchar)(half + (sum & half & 1));
+    }
+}
+
+static void blendMultiplyRow(uchar *dst, const uchar *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = (uchar)div255(dst[i] * src[i]);
+    }
+}
+
+static void blendScreenRow(uchar *dst, const uchar *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        // The source is already inverted.
+        dst[i] = (uchar)(255 - div255((255 - dst[i]) * src[i]));
+    }
+}
+
+Blender::Blender(size_t maxCacheSize)
+: cacheSize(0)
+, maxCacheSize(maxCacheSize)
+{
+}
+
+void Blender::setSrc(const cv::Mat &originalBlendSrc) {
+    std::lock_guard<std::mutex> lock(mutex);
+    originalSrc = originalBlendSrc;
+    cache.clear();
+    cacheSize = 0;
+}
+
+bool Blender::hasSrc() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !originalSrc.empty();
+}
+
+cv::Mat Blender::getPreparedSrc(cv::Size size, int type, BlendMode mode) {
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // Look for a cached source. If found, move it to the front.
+    for (std::list<CacheEntry>::iterator it = cache.begin(); it != cache.end(); it++) {
+        if (it->size == size && it->type == type && it->mode == mode) {
+            cache.splice(cache.begin(), cache, it);
+            return cache.front().preparedSrc;
+        }
+    }
+    
+    // Prepare a new source.
+    CacheEntry entry;
+    entry.size = size;
+    entry.type = type;
+    entry.mode = mode;
+    convertSrc(size, type, entry.preparedSrc);
+    prepareSrc(entry.preparedSrc, mode);
+    cache.push_front(entry);
+    cacheSize += entry.preparedSrc.total() * entry.preparedSrc.elemSize();
+    
+    // Evict the least recently used sources until the cache fits.
+    while (cacheSize > maxCacheSize && cache.size() > 1) {
+        const cv::Mat &evictedSrc = cache.back().preparedSrc;
+        cacheSize -= evictedSrc.total() * evictedSrc.elemSize();
+        cache.pop_back();
+    }
+    
+    return cache.front().preparedSrc;
+}
+
+void Blender::clearCache() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.clear();
+    cacheSize = 0;
+}
+
+void Blender::convertSrc(cv::Size size, int type, cv::Mat &dst) const {
+    
+    // Crop the source to the destination's aspect ratio.
+    double dstAspectRatio = size.width / (double)size.height;
+    
+    int srcW = originalSrc.cols;
+    int srcH = originalSrc.rows;
+    double srcAspectRatio = srcW / (double)srcH;
+    cv::Mat subMat;
+    if (srcAspectRatio < dstAspectRatio) {
+        int subMatH = (int)(srcW / dstAspectRatio);
+        int startRow = (srcH - subMatH) / 2;
+        int endRow = startRow + subMatH;
+        subMat = originalSrc.rowRange(startRow, endRow);
+    } else {
+        int subMatW = (int)(srcH * dstAspectRatio);
+        int startCol = (srcW - subMatW) / 2;
+        int endCol = startCol + subMatW;
+        subMat = originalSrc.colRange(startCol, endCol);
+    }
+    cv::resize(subMat, dst, size, 0.0, 0.0, cv::INTER_LANCZOS4);
+    
+    int dstNumChannels = CV_MAT_CN(type);
+    switch (dst.channels()) {
+        case 1:
+            if (dstNumChannels == 3) {
+                cv::cvtColor(dst, dst, cv::COLOR_GRAY2BGR);
+            } else if (dstNumChannels == 4) {
+                cv::cvtColor(dst, dst, cv::COLOR_GRAY2BGRA);
+            }
+            break;
+        default:
+            switch (dstNumChannels) {
+                case 1:
+                    cv::cvtColor(dst, dst, cv::COLOR_RGBA2GRAY);
+                    break;
+                case 3:
+                    cv::cvtColor(dst, dst, cv::COLOR_RGBA2BGR);
+                    break;
+                default:
+                    cv::cvtColor(dst, dst, cv::COLOR_RGBA2BGRA);
+                    break;
+            }
+            break;
+    }
+}
+
+void Blender::prepareSrc(cv::Mat &blendSrc, BlendMode mode) const {
+    switch (mode) {
+        case Screen:
+            /* Pseudocode:
+             blendSrc = 255 – blendSrc;
+             */
+            cv::subtract(255.0, blendSrc, blendSrc);
+            break;
+        case HUD:
+            /* Pseudocode:
+             blendSrc = 255 – Laplacian(GaussianBlur(blendSrc));
+             */
+            cv::GaussianBlur(blendSrc, blendSrc, cv::Size(5, 5), 0.0);
+            cv::Laplacian(blendSrc, blendSrc, -1, 3);
+            if (blendSrc.channels() > 1) {
+                // The background is in color.
+                // Give the foreground a yellowish green tint, which will stand out against most backgrounds.
+                cv::multiply(cv::Scalar(0.0, 1.0, 0.5), blendSrc, blendSrc);
+            }
+            cv::subtract(255.0, blendSrc, blendSrc);
+            break;
+        default:
+            break;
+    }
+}
+
+void Blender::blend(cv::Mat &mat, const cv::Mat &blendSrc, BlendMode mode) const {
+    
+    void (*blendRow)(uchar *, const uchar *, size_t);
+    switch (mode) {
+        case Average:
+            /* Pseudocode:
+             mat = 0.5 * mat + 0.5 * blendSrc;
+             */
+            blendRow = blendAverageRow;
+            break;
+        case Multiply:
+            /* Pseudocode:
+             mat = mat * blendSrc / 255;
+             */
+            blendRow = blendMultiplyRow;
+            break;
+        case Screen:
+        case HUD:
+            /* Pseudocode:
+             mat = 255 – (255 – mat) * blendSrc / 255;
+             */
+            blendRow = blendScreenRow;
+            break;
+        default:
+            return;
+    }
+    
+    CV_Assert(mat.depth() == CV_8U && mat.type() == blendSrc.type() && mat.size() == blendSrc.size());
+    
+    // If both images are continuous, treat them as one long row.
+    int numRows = mat.rows;
+    size_t rowLength = mat.cols * mat.elemSize();
+    if (mat.isContinuous() && blendSrc.isContinuous()) {
+        rowLength *= numRows;
+        numRows = 1;
+    }
+    for (int y = 0; y < numRows; y++) {
+        blendRow(mat.ptr(y), blendSrc.ptr(y), rowLength);
+    }
+}
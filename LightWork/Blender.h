@@ -0,0 +1,125 @@
+//
+//  Blender.h
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef BLENDER_H
+#define BLENDER_H
+
+#include <list>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+
+#include "BlendMode.h"
+
+/**
+ * A blend engine for 8-bit images.
+ * It has no dependencies on iOS, so it can also run headless.
+ */
+class Blender
+{
+public:
+    /**
+     * Construct a blender whose cache of prepared blending sources holds
+     * up to maxCacheSize bytes. The most recently used source is always
+     * kept, even if it alone exceeds the limit.
+     */
+    Blender(size_t maxCacheSize = 32u * 1024u * 1024u);
+    
+    /**
+     * Set the original blending source, in RGBA or grayscale format.
+     * Any cached, prepared sources are discarded.
+     */
+    void setSrc(const cv::Mat &originalBlendSrc);
+    
+    bool hasSrc() const;
+    
+    /**
+     * Get the blending source, cropped and resized to the given size,
+     * converted to the given type (BGR, BGRA or grayscale), and
+     * prepared for the given mode. The result is cached, keyed by size,
+     * type and mode, so that switching back to a previous configuration
+     * is instant.
+     * The returned header shares the cached data, so it stays valid even
+     * if the source is replaced on another thread.
+     */
+    cv::Mat getPreparedSrc(cv::Size size, int type, BlendMode mode);
+    
+    /**
+     * Discard the cached, prepared sources.
+     */
+    void clearCache();
+    
+    /**
+     * Apply any mode-dependent operations to a blending source, in place.
+     * The source must already match the size and format of the frames.
+     * HUD's preparation is a sequence of separate OpenCV operations (a
+     * blur, a Laplacian, a tint, and an inversion), which is not fused.
+     * It is costly, so use getPreparedSrc, which caches the result,
+     * rather than preparing a source per frame.
+     */
+    void prepareSrc(cv::Mat &blendSrc, BlendMode mode) const;
+    
+    /**
+     * Combine a prepared blending source and a frame, in place.
+     * Each mode runs as a single pass of 8-bit, fixed-point arithmetic.
+     * The frame and the source must be 8-bit, with the same size and
+     * number of channels (for example, grayscale, BGR or BGRA).
+     */
+    void blend(cv::Mat &mat, const cv::Mat &blendSrc, BlendMode mode) const;
+    
+private:
+    struct CacheEntry {
+        cv::Size size;
+        int type;
+        BlendMode mode;
+        cv::Mat preparedSrc;
+    };
+    
+    void convertSrc(cv::Size size, int type, cv::Mat &dst) const;
+    
+    /**
+     * A mutex that guards the original source and the cache.
+     */
+    mutable std::mutex mutex;
+    
+    cv::Mat originalSrc;
+    
+    /**
+     * Prepared sources, ordered from the most recently used to the least.
+     */
+    std::list<CacheEntry> cache;
+    size_t cacheSize;
+    size_t maxCacheSize;
+};
+
+#endif // !BLENDER_H
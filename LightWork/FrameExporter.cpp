@@ -0,0 +1,192 @@
+//
+//  FrameExporter.cpp
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <algorithm>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "FrameExporter.h"
+
+// PNG compression trades file size for encoding time. Level 1 is several
+// times faster than OpenCV's default and still lossless.
+const int PNG_COMPRESSION_LEVEL = 1;
+
+FrameExporter::FrameExporter(size_t maxQueueLength, int jpegQuality)
+: maxQueueLength(std::max(maxQueueLength, (size_t)1))
+, jpegQuality(jpegQuality)
+, framePool(this->maxQueueLength)
+, numReservedSlots(0)
+, numFillingSlots(0)
+, numEncodingSlots(0)
+, numDroppedFrames(0)
+, stopping(false)
+{
+    worker = std::thread(&FrameExporter::run, this);
+}
+
+FrameExporter::~FrameExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobQueued.notify_all();
+    worker.join();
+}
+
+bool FrameExporter::reserve(size_t numFrames) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (getNumFreeSlots() < numFrames) {
+        return false;
+    }
+    numReservedSlots += numFrames;
+    return true;
+}
+
+void FrameExporter::releaseReservation(size_t numFrames) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        numReservedSlots -= std::min(numFrames, numReservedSlots);
+    }
+    slotFreed.notify_all();
+}
+
+bool FrameExporter::exportFrame(const cv::Mat &frame, const std::string &path, Format format, const Callback &callback, bool wait) {
+    
+    Job job;
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        // Claim a slot.
+        if (numReservedSlots > 0) {
+            numReservedSlots--;
+        } else if (getNumFreeSlots() == 0) {
+            if (!wait) {
+                numDroppedFrames++;
+                return false;
+            }
+            slotFreed.wait(lock, [this] {
+                return getNumFreeSlots() > 0;
+            });
+        }
+        numFillingSlots++;
+    }
+    
+    // Copy the frame outside the lock, so that the worker is not blocked.
+    job.frame = framePool.leaseCopy(frame);
+    job.path = path;
+    job.format = format;
+    job.callback = callback;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        numFillingSlots--;
+        jobs.push_back(std::move(job));
+    }
+    jobQueued.notify_one();
+    
+    return true;
+}
+
+void FrameExporter::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    slotFreed.wait(lock, [this] {
+        return jobs.empty() && numFillingSlots == 0 && numEncodingSlots == 0;
+    });
+}
+
+size_t FrameExporter::getMaxQueueLength() const {
+    return maxQueueLength;
+}
+
+size_t FrameExporter::getNumDroppedFrames() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numDroppedFrames;
+}
+
+size_t FrameExporter::getNumFreeSlots() const {
+    size_t numUsedSlots = jobs.size() + numReservedSlots + numFillingSlots + numEncodingSlots;
+    return (numUsedSlots < maxQueueLength) ? maxQueueLength - numUsedSlots : 0;
+}
+
+void FrameExporter::run() {
+    
+    std::vector<int> pngParams;
+    pngParams.push_back(cv::IMWRITE_PNG_COMPRESSION);
+    pngParams.push_back(PNG_COMPRESSION_LEVEL);
+    
+    std::vector<int> jpegParams;
+    jpegParams.push_back(cv::IMWRITE_JPEG_QUALITY);
+    jpegParams.push_back(jpegQuality);
+    
+    while (true) {
+        
+        Job job;
+        
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobQueued.wait(lock, [this] {
+                return stopping || !jobs.empty();
+            });
+            if (jobs.empty()) {
+                // The exporter is stopping and the queue is drained.
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            numEncodingSlots++;
+        }
+        
+        // Encode and write the frame. OpenCV expects BGR(A) channel
+        // order, which matches the camera's frames, and JPEG drops alpha.
+        bool success;
+        try {
+            success = cv::imwrite(job.path, *job.frame, (job.format == PNG) ? pngParams : jpegParams);
+        } catch (const cv::Exception &) {
+            success = false;
+        }
+        
+        if (job.callback) {
+            job.callback(job.path, success);
+        }
+        
+        // Return the buffer to the pool.
+        job.frame.reset();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            numEncodingSlots--;
+        }
+        slotFreed.notify_all();
+    }
+}
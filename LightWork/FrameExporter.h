@@ -0,0 +1,153 @@
+//
+//  FrameExporter.h
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef FRAME_EXPORTER_H
+#define FRAME_EXPORTER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "FramePool.h"
+
+/**
+ * An asynchronous exporter that encodes frames as PNG or JPEG files on a
+ * worker thread, in the order they were submitted.
+ * The queue is bounded. Its buffers are leased from a frame pool, so a
+ * steady stream of same-sized frames does not allocate.
+ * It has no dependencies on iOS, so it can also run headless.
+ */
+class FrameExporter
+{
+public:
+    enum Format {
+        PNG,
+        JPEG
+    };
+    
+    /**
+     * A function that is called on the worker thread after a frame has
+     * been written, or has failed to be written, to the given path.
+     */
+    typedef std::function<void(const std::string &path, bool success)> Callback;
+    
+    /**
+     * Construct an exporter that holds up to maxQueueLength frames,
+     * including the one being encoded.
+     */
+    FrameExporter(size_t maxQueueLength = 8, int jpegQuality = 95);
+    
+    /**
+     * Finish exporting any queued frames, then stop the worker thread.
+     */
+    ~FrameExporter();
+    
+    /**
+     * Try to reserve queue slots for a burst of numFrames consecutive
+     * frames. This does not block. Returns false, and reserves nothing,
+     * if fewer than numFrames slots are free.
+     */
+    bool reserve(size_t numFrames);
+    
+    /**
+     * Release up to numFrames reserved slots that will not be used, for
+     * example because a burst was interrupted.
+     */
+    void releaseReservation(size_t numFrames);
+    
+    /**
+     * Copy a grayscale, BGR, or BGRA frame and queue it for export.
+     * A reserved slot is used if one is available. Otherwise, if the
+     * queue is full, the frame is dropped and false is returned, unless
+     * wait is true, in which case the caller blocks until a slot is free.
+     */
+    bool exportFrame(const cv::Mat &frame, const std::string &path, Format format, const Callback &callback, bool wait = false);
+    
+    /**
+     * Block until every queued frame has been exported.
+     */
+    void waitUntilIdle();
+    
+    size_t getMaxQueueLength() const;
+    
+    /**
+     * Get the number of frames that were dropped because the queue was full.
+     */
+    size_t getNumDroppedFrames() const;
+    
+private:
+    struct Job {
+        FramePool::Lease frame;
+        std::string path;
+        Format format;
+        Callback callback;
+    };
+    
+    size_t getNumFreeSlots() const;
+    void run();
+    
+    size_t maxQueueLength;
+    int jpegQuality;
+    
+    FramePool framePool;
+    
+    /**
+     * A mutex that guards all of the following members.
+     */
+    mutable std::mutex mutex;
+    std::condition_variable jobQueued;
+    std::condition_variable slotFreed;
+    
+    std::deque<Job> jobs;
+    
+    /**
+     * Slots that are reserved for bursts, being filled by a caller, or
+     * being encoded, respectively.
+     */
+    size_t numReservedSlots;
+    size_t numFillingSlots;
+    size_t numEncodingSlots;
+    
+    size_t numDroppedFrames;
+    bool stopping;
+    
+    std::thread worker;
+};
+
+#endif // !FRAME_EXPORTER_H
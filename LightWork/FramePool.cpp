@@ -0,0 +1,149 @@
+//
+//  FramePool.cpp
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <algorithm>
+#include <atomic>
+
+#include "FramePool.h"
+
+// The smallest buffer size, in bytes. Smaller images share this class.
+const size_t BUFFER_MIN_SIZE = 4096;
+
+FramePool::FramePool(size_t maxNumIdleBuffersPerSize)
+: maxNumIdleBuffersPerSize(maxNumIdleBuffersPerSize)
+, numAllocations(0)
+{
+}
+
+FramePool::Lease FramePool::lease(int rows, int cols, int type) {
+    
+    size_t numBytes = (size_t)rows * (size_t)cols * CV_ELEM_SIZE(type);
+    size_t bufferSize = getBufferSize(numBytes);
+    
+    std::shared_ptr<Slot> slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        // Reuse an idle slot of the right size class, and free any idle
+        // slots beyond the limit.
+        std::vector<std::shared_ptr<Slot>> &sizeSlots = slots[bufferSize];
+        size_t numIdleSlots = 0;
+        for (size_t i = 0; i < sizeSlots.size();) {
+            if (!isIdle(sizeSlots[i])) {
+                i++;
+            } else if (!slot) {
+                slot = sizeSlots[i];
+                i++;
+            } else if (numIdleSlots < maxNumIdleBuffersPerSize) {
+                numIdleSlots++;
+                i++;
+            } else {
+                sizeSlots[i] = sizeSlots.back();
+                sizeSlots.pop_back();
+            }
+        }
+        if (!slot) {
+            numAllocations++;
+        }
+    }
+    
+    // Otherwise, allocate a slot, without holding the lock.
+    if (!slot) {
+        slot = std::make_shared<Slot>();
+        slot->buffer.create(1, (int)bufferSize, CV_8UC1);
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[bufferSize].push_back(slot);
+    }
+    
+    // Wrap the buffer's data in a header of the requested size and type.
+    // The lease shares the slot's reference count, so no control block is
+    // allocated, and the slot becomes idle when the last copy is released.
+    slot->header = cv::Mat(rows, cols, type, slot->buffer.data);
+    return Lease(slot, &slot->header);
+}
+
+FramePool::Lease FramePool::leaseCopy(const cv::Mat &src) {
+    Lease dst = lease(src.rows, src.cols, src.type());
+    src.copyTo(*dst);
+    return dst;
+}
+
+void FramePool::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : slots) {
+        std::vector<std::shared_ptr<Slot>> &sizeSlots = entry.second;
+        sizeSlots.erase(std::remove_if(sizeSlots.begin(), sizeSlots.end(), isIdle), sizeSlots.end());
+    }
+}
+
+size_t FramePool::getNumAllocations() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numAllocations;
+}
+
+size_t FramePool::getNumIdleBuffers() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t numIdleBuffers = 0;
+    for (const auto &entry : slots) {
+        numIdleBuffers += std::count_if(entry.second.begin(), entry.second.end(), isIdle);
+    }
+    return numIdleBuffers;
+}
+
+bool FramePool::isIdle(const std::shared_ptr<Slot> &slot) {
+    if (slot.use_count() != 1) {
+        return false;
+    }
+    
+    // The pool holds the only reference, and new references are only made
+    // from existing ones, so the slot stays idle. Synchronize with the
+    // release of the last lease, so that its writes to the buffer are
+    // complete before the buffer is reused.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+size_t FramePool::getBufferSize(size_t numBytes) {
+    if (numBytes <= BUFFER_MIN_SIZE) {
+        return BUFFER_MIN_SIZE;
+    }
+    
+    // Find the octave, 2^k < numBytes <= 2^(k+1), and round up to the next
+    // quarter of it. At most 25% of a buffer is wasted.
+    size_t octave = BUFFER_MIN_SIZE;
+    while (octave * 2 < numBytes) {
+        octave *= 2;
+    }
+    size_t step = octave / 4;
+    return (numBytes + step - 1) / step * step;
+}
@@ -0,0 +1,315 @@
+//
+//  VideoBlendRenderer.cpp
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "VideoBlendRenderer.h"
+
+// If the input does not report its frame rate, the output uses this one.
+const double DEFAULT_FPS = 30.0;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * A queue of frames between two stages. A producer blocks while it is
+ * full, and a consumer blocks while it is empty and open.
+ * If a stage fails, the queue is cancelled, which wakes both sides.
+ */
+class FrameQueue
+{
+public:
+    FrameQueue(size_t maxLength)
+    : maxLength(maxLength)
+    , closed(false)
+    , cancelled(false)
+    {
+    }
+    
+    /**
+     * Add a frame. Returns false if the queue is cancelled.
+     */
+    bool push(const FramePool::Lease &frame) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] {
+            return cancelled || frames.size() < maxLength;
+        });
+        if (cancelled) {
+            return false;
+        }
+        frames.push_back(frame);
+        notEmpty.notify_one();
+        return true;
+    }
+    
+    /**
+     * Take the next frame. Returns false if the queue is closed and empty,
+     * or cancelled.
+     */
+    bool pop(FramePool::Lease &frame) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] {
+            return closed || cancelled || !frames.empty();
+        });
+        if (cancelled || frames.empty()) {
+            return false;
+        }
+        frame = frames.front();
+        frames.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    
+    /**
+     * Signal that no more frames will be pushed.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+    
+    /**
+     * Discard the queued frames, and make any waiting or later push or
+     * pop fail.
+     */
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        frames.clear();
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+    
+private:
+    size_t maxLength;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<FramePool::Lease> frames;
+    bool closed;
+    bool cancelled;
+};
+
+/**
+ * Get the seconds from a start time to now.
+ */
+static double getSecondsSince(const Clock::time_point &start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+VideoBlendRenderer::VideoBlendRenderer(size_t maxQueueLength)
+: maxQueueLength(std::max(maxQueueLength, (size_t)1))
+, framePool(2 * this->maxQueueLength + 3)
+{
+    stats = Stats();
+}
+
+bool VideoBlendRenderer::setSrc(const cv::Mat &originalBlendSrc) {
+    
+    if (originalBlendSrc.empty() || originalBlendSrc.depth() != CV_8U) {
+        return false;
+    }
+    
+    // The blender expects RGBA or grayscale. Convert a BGR source, such
+    // as one from imread.
+    switch (originalBlendSrc.channels()) {
+        case 1:
+        case 4:
+            blender.setSrc(originalBlendSrc);
+            return true;
+        case 3: {
+            cv::Mat rgbaBlendSrc;
+            cv::cvtColor(originalBlendSrc, rgbaBlendSrc, cv::COLOR_BGR2RGBA);
+            blender.setSrc(rgbaBlendSrc);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool VideoBlendRenderer::render(const std::string &inputPath, const std::string &outputPath, BlendMode mode, int fourcc, double fps) {
+    
+    stats = Stats();
+    
+    if (mode != None && !blender.hasSrc()) {
+        return false;
+    }
+    
+    cv::VideoCapture capture(inputPath);
+    if (!capture.isOpened()) {
+        return false;
+    }
+    cv::Size frameSize((int)capture.get(cv::CAP_PROP_FRAME_WIDTH), (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    if (fps <= 0.0) {
+        fps = capture.get(cv::CAP_PROP_FPS);
+        if (fps <= 0.0) {
+            fps = DEFAULT_FPS;
+        }
+    }
+    cv::VideoWriter writer(outputPath, fourcc, fps, frameSize);
+    if (!writer.isOpened()) {
+        return false;
+    }
+    
+    // The frames are blended in BGR format, as they are decoded and
+    // encoded, so no stage converts them. Prepare the blending source
+    // once, before the pipeline starts.
+    cv::Mat blendSrc;
+    if (mode != None) {
+        try {
+            blendSrc = blender.getPreparedSrc(frameSize, CV_8UC3, mode);
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    
+    FrameQueue decodedFrames(maxQueueLength);
+    FrameQueue blendedFrames(maxQueueLength);
+    double decodeTime = 0.0;
+    double blendTime = 0.0;
+    double encodeTime = 0.0;
+    uint64_t numFrames = 0ull;
+    
+    // If any stage fails, it cancels both queues, so that the other
+    // stages stop instead of waiting for it.
+    std::atomic<bool> failed(false);
+    auto fail = [&failed, &decodedFrames, &blendedFrames] {
+        failed = true;
+        decodedFrames.cancel();
+        blendedFrames.cancel();
+    };
+    
+    Clock::time_point startTime = Clock::now();
+    
+    // Decode each frame into a pooled BGR buffer.
+    std::thread decodeThread([this, &capture, frameSize, &decodedFrames, &decodeTime, &fail] {
+        try {
+            cv::Mat decodedFrame;
+            while (true) {
+                Clock::time_point workStartTime = Clock::now();
+                if (!capture.read(decodedFrame) || decodedFrame.empty()) {
+                    break;
+                }
+                if (decodedFrame.size() != frameSize) {
+                    // The writer cannot change size midway, so stop here.
+                    break;
+                }
+                FramePool::Lease frame = framePool.lease(frameSize.height, frameSize.width, CV_8UC3);
+                switch (decodedFrame.channels()) {
+                    case 1:
+                        cv::cvtColor(decodedFrame, *frame, cv::COLOR_GRAY2BGR);
+                        break;
+                    case 4:
+                        cv::cvtColor(decodedFrame, *frame, cv::COLOR_BGRA2BGR);
+                        break;
+                    default:
+                        decodedFrame.copyTo(*frame);
+                        break;
+                }
+                decodeTime += getSecondsSince(workStartTime);
+                if (!decodedFrames.push(frame)) {
+                    return;
+                }
+            }
+        } catch (const std::exception &) {
+            fail();
+        }
+        decodedFrames.close();
+    });
+    
+    // Blend each frame in place.
+    std::thread blendThread([this, mode, &blendSrc, &decodedFrames, &blendedFrames, &blendTime, &fail] {
+        try {
+            FramePool::Lease frame;
+            while (decodedFrames.pop(frame)) {
+                Clock::time_point workStartTime = Clock::now();
+                if (mode != None) {
+                    blender.blend(*frame, blendSrc, mode);
+                }
+                blendTime += getSecondsSince(workStartTime);
+                if (!blendedFrames.push(frame)) {
+                    return;
+                }
+                frame.reset();
+            }
+        } catch (const std::exception &) {
+            fail();
+        }
+        blendedFrames.close();
+    });
+    
+    // Encode each frame, on this thread.
+    try {
+        FramePool::Lease frame;
+        while (blendedFrames.pop(frame)) {
+            Clock::time_point workStartTime = Clock::now();
+            writer.write(*frame);
+            
+            // Return the buffer to the pool before the next frame.
+            frame.reset();
+            
+            encodeTime += getSecondsSince(workStartTime);
+            numFrames++;
+        }
+    } catch (const std::exception &) {
+        fail();
+    }
+    
+    decodeThread.join();
+    blendThread.join();
+    writer.release();
+    
+    stats.numFrames = numFrames;
+    stats.elapsedTime = getSecondsSince(startTime);
+    if (stats.elapsedTime > 0.0) {
+        stats.framesPerSecond = numFrames / stats.elapsedTime;
+        stats.decodeUtilization = decodeTime / stats.elapsedTime;
+        stats.blendUtilization = blendTime / stats.elapsedTime;
+        stats.encodeUtilization = encodeTime / stats.elapsedTime;
+    }
+    return !failed;
+}
+
+const VideoBlendRenderer::Stats &VideoBlendRenderer::getStats() const {
+    return stats;
+}
@@ -0,0 +1,117 @@
+//
+//  VideoBlendRenderer.h
+//  LightWork
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef VIDEO_BLEND_RENDERER_H
+#define VIDEO_BLEND_RENDERER_H
+
+#include <stdint.h>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+#include "BlendMode.h"
+#include "Blender.h"
+#include "FramePool.h"
+
+/**
+ * A renderer that applies a blend mode to every frame of a video file
+ * and writes the result to another video file.
+ * Decoding, blending, and encoding run as three pipelined stages, on
+ * their own threads, connected by bounded queues. The frames' buffers
+ * are leased from a frame pool, so a long video does not allocate per
+ * frame once the pipeline is full.
+ * It has no dependencies on iOS, so it can run headless, for example, on
+ * a server.
+ */
+class VideoBlendRenderer
+{
+public:
+    struct Stats {
+        uint64_t numFrames;
+        
+        /**
+         * The wall-clock time of the whole render, in seconds, and the
+         * sustained rate.
+         */
+        double elapsedTime;
+        double framesPerSecond;
+        
+        /**
+         * The fraction of the elapsed time that each stage spent working,
+         * as opposed to waiting for the next or previous stage.
+         * The busiest stage is the bottleneck.
+         */
+        double decodeUtilization;
+        double blendUtilization;
+        double encodeUtilization;
+    };
+    
+    /**
+     * Construct a renderer whose queues hold up to maxQueueLength frames
+     * between each pair of stages.
+     */
+    VideoBlendRenderer(size_t maxQueueLength = 4);
+    
+    /**
+     * Set the original blending source, in 8-bit BGR (as from imread),
+     * RGBA, or grayscale format.
+     * It is prepared once for the video's frame size and the mode.
+     * Returns false, and keeps the previous source, if the format is not
+     * supported.
+     */
+    bool setSrc(const cv::Mat &originalBlendSrc);
+    
+    /**
+     * Render a video, blocking until it is done.
+     * If fps is positive, it overrides the input's frame rate.
+     * Returns false if the input cannot be opened, the output cannot be
+     * created, a blend mode other than None has no blending source, or
+     * any stage fails. If a stage fails, the pipeline stops, and the
+     * output holds the frames that were encoded until then.
+     */
+    bool render(const std::string &inputPath, const std::string &outputPath, BlendMode mode, int fourcc, double fps = 0.0);
+    
+    /**
+     * Get the statistics of the last render.
+     */
+    const Stats &getStats() const;
+    
+private:
+    size_t maxQueueLength;
+    
+    Blender blender;
+    FramePool framePool;
+    
+    Stats stats;
+};
+
+#endif // !VIDEO_BLEND_RENDERER_H
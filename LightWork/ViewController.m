@@ -39,29 +39,26 @@
 #import <opencv2/imgcodecs/ios.h>
 #import <opencv2/imgproc.hpp>
 
+#import "Blender.h"
+#import "FrameExporter.h"
 #import "ViewController.h"
 #import "VideoCamera.h"
 
-
-enum BlendMode {
-    None,
-    Average,
-    Multiply,
-    Screen,
-    HUD
-};
+// The number of consecutive video frames that are saved each time the
+// Save button is pressed. The export queue must be at least this long.
+const size_t SAVE_BURST_LENGTH = 1;
+const size_t EXPORT_MAX_QUEUE_LENGTH = 8;
 
 
 @interface ViewController () <CvVideoCameraDelegate, UIImagePickerControllerDelegate, UINavigationControllerDelegate> {
     cv::Mat originalStillMat;
     cv::Mat updatedStillMatGray;
     cv::Mat updatedStillMatRGBA;
-    cv::Mat updatedVideoMatGray;
-    cv::Mat updatedVideoMatRGBA;
-    cv::Mat originalBlendSrcMat;
-    cv::Mat convertedBlendSrcMat;
     
-    BlendMode _blendMode;
+    Blender *blender;
+    FrameExporter *frameExporter;
+    
+    id<NSObject> backgroundObserver;
 }
 
 @property IBOutlet UIImageView *imageView;
@@ -69,10 +66,15 @@ enum BlendMode {
 @property IBOutlet UIToolbar *toolbar;
 
 @property VideoCamera *videoCamera;
-@property BOOL saveNextFrame;
+// The burst's counters are guarded by @synchronized (self), because the
+// capture thread queues the frames. The saved paths and the number of
+// finished frames are only used on the main queue.
+@property NSUInteger numFramesToSave;
+@property NSUInteger numFramesQueued;
+@property NSUInteger numFramesFinished;
+@property NSMutableArray *savedImagePaths;
 
 @property BlendMode blendMode;
-@property BOOL blendSettingsChanged;
 
 - (IBAction)onTapToSetPointOfInterest:(UITapGestureRecognizer *)tapGesture;
 - (IBAction)onColorModeSelected:(UISegmentedControl *)segmentedControl;
@@ -84,34 +86,28 @@ enum BlendMode {
 - (void)refresh;
 - (void)processImage:(cv::Mat &)mat;
 - (void)processImageHelper:(cv::Mat &)mat;
-- (void)saveImage:(UIImage *)image;
+- (void)exportMat:(cv::Mat &)mat index:(NSUInteger)index;
+- (void)finishExportingFrameAtPath:(NSString *)path success:(BOOL)success;
+- (void)cancelBurst;
+- (void)addImagesToPhotosLibraryAtPaths:(NSArray *)paths;
 - (void)showSaveImageFailureAlertWithMessage:(NSString *)message;
 - (void)showSaveImageSuccessAlertWithImage:(UIImage *)image;
 - (UIAlertAction *)shareImageActionWithTitle:(NSString *)title serviceType:(NSString *)serviceType image:(UIImage *)image;
 - (void)startBusyMode;
 - (void)stopBusyMode;
 - (UIAlertAction *)blendModeActionWithTitle:(NSString *)title blendMode:(BlendMode)blendMode;
-- (void)convertBlendSrcMatToWidth:(int)dstW height:(int)dstH;
 
 @end
 
 
 @implementation ViewController
 
-- (BlendMode)blendMode {
-    return _blendMode;
-}
-
-- (void)setBlendMode:(BlendMode)blendMode {
-    if (blendMode != _blendMode) {
-        _blendMode = blendMode;
-        self.blendSettingsChanged = YES;
-    }
-}
-
 - (void)viewDidLoad {
     [super viewDidLoad];
     
+    blender = new Blender();
+    frameExporter = new FrameExporter(EXPORT_MAX_QUEUE_LENGTH);
+    
     UIImage *originalStillImage = [UIImage imageNamed:@"Fleur.jpg"];
     UIImageToMat(originalStillImage, originalStillMat);
     
@@ -120,6 +116,32 @@ enum BlendMode {
     self.videoCamera.defaultAVCaptureSessionPreset = AVCaptureSessionPresetHigh;
     self.videoCamera.defaultFPS = 30;
     self.videoCamera.letterboxPreview = YES;
+    
+    // When the application enters the background, the camera stops.
+    // Give up on any unfinished burst, so that its reserved export slots
+    // are released.
+    NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
+    NSOperationQueue *queue = [NSOperationQueue mainQueue];
+    __weak ViewController *weakSelf = self;
+    backgroundObserver = [notificationCenter addObserverForName:UIApplicationDidEnterBackgroundNotification object:nil queue:queue usingBlock:^(NSNotification *note) {
+        [weakSelf cancelBurst];
+    }];
+}
+
+- (void)dealloc {
+    if (backgroundObserver != nil) {
+        [[NSNotificationCenter defaultCenter] removeObserver:backgroundObserver];
+        backgroundObserver = nil;
+    }
+    if (blender != NULL) {
+        delete blender;
+        blender = NULL;
+    }
+    if (frameExporter != NULL) {
+        // Finish exporting any queued frames.
+        delete frameExporter;
+        frameExporter = NULL;
+    }
 }
 
 - (void)viewDidLayoutSubviews {
@@ -173,6 +195,7 @@ enum BlendMode {
                 [self refresh];
                 break;
             default:
+                [self cancelBurst];
                 [self.videoCamera stop];
                 [self refresh];
                 break;
@@ -190,10 +213,33 @@ enum BlendMode {
 
 - (IBAction)onSaveButtonPressed {
     [self startBusyMode];
+    self.savedImagePaths = [NSMutableArray array];
+    self.numFramesFinished = 0;
     if (self.videoCamera.running) {
-        self.saveNextFrame = YES;
+        // Reserve space in the export queue for the whole burst, so that
+        // none of its frames are dropped or stall the capture thread.
+        // If the queue is too busy, do not wait for it.
+        if (!frameExporter->reserve(SAVE_BURST_LENGTH)) {
+            [self showSaveImageFailureAlertWithMessage:@"Previous images are still being saved. Please try again in a moment."];
+            return;
+        }
+        @synchronized (self) {
+            self.numFramesQueued = 0;
+            self.numFramesToSave = SAVE_BURST_LENGTH;
+        }
     } else {
-        [self saveImage:self.imageView.image];
+        @synchronized (self) {
+            self.numFramesQueued = 1;
+            self.numFramesToSave = 0;
+        }
+        if (self.videoCamera.grayscaleMode) {
+            [self exportMat:updatedStillMatGray index:0];
+        } else {
+            // The exporter expects BGRA channel order.
+            cv::Mat stillMatBGRA;
+            cv::cvtColor(updatedStillMatRGBA, stillMatBGRA, cv::COLOR_RGBA2BGRA);
+            [self exportMat:stillMatBGRA index:0];
+        }
     }
 }
 
@@ -242,112 +288,120 @@ enum BlendMode {
     
     [self processImageHelper:mat];
     
-    if (self.saveNextFrame) {
-        // The video frame, 'mat', is not safe for long-running
-        // operations such as saving to file. Thus, we copy its
-        // data to another cv::Mat first.
-        UIImage *image;
-        if (self.videoCamera.grayscaleMode) {
-            mat.copyTo(updatedVideoMatGray);
-            image = MatToUIImage(updatedVideoMatGray);
-        } else {
-            cv::cvtColor(mat, updatedVideoMatRGBA, cv::COLOR_BGRA2RGBA);
-            image = MatToUIImage(updatedVideoMatRGBA);
+    @synchronized (self) {
+        if (self.numFramesToSave > 0) {
+            // The exporter copies the frame, so 'mat' is not held beyond
+            // this callback. Encoding happens on the exporter's thread.
+            [self exportMat:mat index:self.numFramesQueued];
+            self.numFramesQueued++;
+            self.numFramesToSave--;
         }
-        [self saveImage:image];
-        self.saveNextFrame = NO;
     }
 }
 
 - (void)processImageHelper:(cv::Mat &)mat {
     
-    if (originalBlendSrcMat.empty()) {
-        // No blending source has been selected.
+    if (!blender->hasSrc() || self.blendMode == None) {
+        // No blending source or mode has been selected.
         // Do nothing.
         return;
     }
     
-    if (convertedBlendSrcMat.rows != mat.rows || convertedBlendSrcMat.cols != mat.cols || convertedBlendSrcMat.type() != mat.type() || self.blendSettingsChanged) {
-        
-        // Resize the blending source and convert its format.
-        [self convertBlendSrcMatToWidth:mat.cols height:mat.rows];
+    // Get the blending source, resized, converted, and prepared for the mode.
+    // The blender caches it for each combination of size, format, and mode.
+    cv::Mat blendSrcMat = blender->getPreparedSrc(cv::Size(mat.cols, mat.rows), mat.type(), self.blendMode);
+    
+    // Combine the blending source and the current frame.
+    blender->blend(mat, blendSrcMat, self.blendMode);
+}
+
+- (void)exportMat:(cv::Mat &)mat index:(NSUInteger)index {
+    
+    // Queue the image to be saved to a temporary file.
+    // This does not block. A burst's frames use its reserved slots, and a
+    // still image is not saved if the queue is full.
+    NSString *outputPath = [NSString stringWithFormat:@"%@output%lu.png", NSTemporaryDirectory(), (unsigned long)index];
+    bool queued = frameExporter->exportFrame(mat, outputPath.UTF8String, FrameExporter::PNG, [self](const std::string &path, bool success) {
         
-        // Apply any mode-dependent operations to the blending source.
-        switch (self.blendMode) {
-            case Screen:
-                /* Pseudocode:
-                 convertedBlendSrcMat = 255 – convertedBlendSrcMat;
-                 */
-                cv::subtract(255.0, convertedBlendSrcMat, convertedBlendSrcMat);
-                break;
-            case HUD:
-                /* Pseudocode:
-                 convertedBlendSrcMat = 255 – Laplacian(GaussianBlur(convertedBlendSrcMat));
-                 */
-                cv::GaussianBlur(convertedBlendSrcMat, convertedBlendSrcMat, cv::Size(5, 5), 0.0);
-                cv::Laplacian(convertedBlendSrcMat, convertedBlendSrcMat, -1, 3);
-                if (!self.videoCamera.grayscaleMode) {
-                    // The background is in color.
-                    // Give the foreground a yellowish green tint, which will stand out against most backgrounds.
-                    cv::multiply(cv::Scalar(0.0, 1.0, 0.5), convertedBlendSrcMat, convertedBlendSrcMat);
-                }
-                cv::subtract(255.0, convertedBlendSrcMat, convertedBlendSrcMat);
-                break;
-            default:
-                break;
+        // This runs on the exporter's thread, in the order that the
+        // images were queued. Finish on the main queue, which preserves
+        // the order.
+        NSString *savedPath = [NSString stringWithUTF8String:path.c_str()];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self finishExportingFrameAtPath:savedPath success:success];
+        });
+    });
+    if (!queued) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self finishExportingFrameAtPath:outputPath success:NO];
+        });
+    }
+}
+
+- (void)finishExportingFrameAtPath:(NSString *)path success:(BOOL)success {
+    
+    if (success) {
+        [self.savedImagePaths addObject:path];
+    }
+    self.numFramesFinished++;
+    
+    @synchronized (self) {
+        if (self.numFramesToSave > 0 || self.numFramesFinished < self.numFramesQueued) {
+            // More images are coming.
+            return;
         }
-        
-        self.blendSettingsChanged = NO;
     }
     
-    // Combine the blending source and the current frame.
-    switch (self.blendMode) {
-        case Average:
-            /* Pseudocode:
-             mat = 0.5 * mat + 0.5 * convertedBlendSrcMat;
-             */
-            cv::addWeighted(mat, 0.5, convertedBlendSrcMat, 0.5, 0.0, mat);
-            break;
-        case Multiply:
-            /* Pseudocode:
-             mat = mat * convertedBlendSrcMat / 255;
-             */
-            cv::multiply(mat, convertedBlendSrcMat, mat, 1.0 / 255.0);
-            break;
-        case Screen:
-        case HUD:
-            /* Pseudocode:
-             mat = 255 – (255 – mat) * convertedBlendSrcMat / 255;
-             */
-            cv::subtract(255.0, mat, mat);
-            cv::multiply(mat, convertedBlendSrcMat, mat, 1.0 / 255.0);
-            cv::subtract(255.0, mat, mat);
-            break;
-        default:
-            break;
+    // The last image has been saved.
+    [self addImagesToPhotosLibraryAtPaths:self.savedImagePaths];
+}
+
+- (void)cancelBurst {
+    
+    NSUInteger numFramesNotQueued;
+    @synchronized (self) {
+        numFramesNotQueued = self.numFramesToSave;
+        self.numFramesToSave = 0;
     }
+    if (numFramesNotQueued == 0) {
+        // No burst is in progress.
+        return;
+    }
+    
+    // Return the unused slots to the export queue.
+    frameExporter->releaseReservation(numFramesNotQueued);
+    
+    @synchronized (self) {
+        if (self.numFramesFinished < self.numFramesQueued) {
+            // The images that were queued will finish the burst.
+            return;
+        }
+    }
+    
+    // Save whatever was exported before the burst was interrupted.
+    [self addImagesToPhotosLibraryAtPaths:self.savedImagePaths];
 }
 
-- (void)saveImage:(UIImage *)image {
+- (void)addImagesToPhotosLibraryAtPaths:(NSArray *)paths {
     
-    // Try to save the image to a temporary file.
-    NSString *outputPath = [NSString stringWithFormat:@"%@%@", NSTemporaryDirectory(), @"output.png"];
-    if (![UIImagePNGRepresentation(image) writeToFile:outputPath atomically:YES]) {
-        
+    if (paths.count == 0) {
         // Show an alert describing the failure.
         [self showSaveImageFailureAlertWithMessage:@"The image could not be saved to the temporary directory."];
         
         return;
     }
     
-    // Try to add the image to the Photos library.
-    NSURL *outputURL = [NSURL URLWithString:outputPath];
+    // Try to add the images to the Photos library.
     PHPhotoLibrary *photoLibrary = [PHPhotoLibrary sharedPhotoLibrary];
     [photoLibrary performChanges:^{
-        [PHAssetChangeRequest creationRequestForAssetFromImageAtFileURL:outputURL];
+        for (NSString *path in paths) {
+            [PHAssetChangeRequest creationRequestForAssetFromImageAtFileURL:[NSURL fileURLWithPath:path]];
+        }
     } completionHandler:^(BOOL success, NSError *error) {
         if (success) {
-            // Show an alert describing the success, with sharing options.
+            // Show an alert describing the success, with sharing options
+            // for the last image.
+            UIImage *image = [UIImage imageWithContentsOfFile:paths.lastObject];
             [self showSaveImageSuccessAlertWithImage:image];
         } else {
             // Show an alert describing the failure.
@@ -461,15 +515,15 @@ enum BlendMode {
     [picker dismissViewControllerAnimated:YES completion:nil];
     
     UIImage *image = [info objectForKey:@"UIImagePickerControllerOriginalImage"];
+    cv::Mat originalBlendSrcMat;
     UIImageToMat(image, originalBlendSrcMat);
+    blender->setSrc(originalBlendSrcMat);
     
     if (self.blendMode == None) {
         // Blending is currently deactivated.
         // Activate "Average" blending so that the user sees some result.
         self.blendMode = Average;
     }
-    
-    self.blendSettingsChanged = YES;
 }
 
 - (void)imagePickerControllerDidCancel:(UIImagePickerController *)picker {
@@ -508,41 +562,4 @@ enum BlendMode {
     return action;
 }
 
-- (void)convertBlendSrcMatToWidth:(int)dstW height:(int)dstH {
-    
-    double dstAspectRatio = dstW / (double)dstH;
-    
-    int srcW = originalBlendSrcMat.cols;
-    int srcH = originalBlendSrcMat.rows;
-    double srcAspectRatio = srcW / (double)srcH;
-    cv::Mat subMat;
-    if (srcAspectRatio < dstAspectRatio) {
-        int subMatH = (int)(srcW / dstAspectRatio);
-        int startRow = (srcH - subMatH) / 2;
-        int endRow = startRow + subMatH;
-        subMat = originalBlendSrcMat.rowRange(startRow, endRow);
-    } else {
-        int subMatW = (int)(srcH * dstAspectRatio);
-        int startCol = (srcW - subMatW) / 2;
-        int endCol = startCol + subMatW;
-        subMat = originalBlendSrcMat.colRange(startCol, endCol);
-    }
-    cv::resize(subMat, convertedBlendSrcMat, cv::Size(dstW, dstH), 0.0, 0.0, cv::INTER_LANCZOS4);
-    
-    switch (convertedBlendSrcMat.channels()) {
-        case 1:
-            if (!self.videoCamera.grayscaleMode) {
-                cv::cvtColor(convertedBlendSrcMat, convertedBlendSrcMat, cv::COLOR_GRAY2BGRA);
-            }
-            break;
-        default:
-            if (self.videoCamera.grayscaleMode) {
-                cv::cvtColor(convertedBlendSrcMat, convertedBlendSrcMat, cv::COLOR_RGBA2GRAY);
-            } else {
-                cv::cvtColor(convertedBlendSrcMat, convertedBlendSrcMat, cv::COLOR_RGBA2BGRA);
-            }
-            break;
-    }
-}
-
 @end
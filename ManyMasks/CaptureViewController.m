@@ -36,14 +36,26 @@
 #import <opencv2/imgproc.hpp>
 
 #import "CaptureViewController.h"
+#import "CascadeCache.h"
 #import "FaceDetector.h"
+#import "FramePool.h"
+#import "ResizeFactorController.h"
 #import "ReviewViewController.h"
 #import "VideoCamera.h"
 
+// The initial and limiting resize factors for face detection.
+// The factor adapts to keep detection within the target latency, in
+// seconds. Detection runs in the camera callback, so the target leaves
+// part of each frame's time for the preview.
 const double DETECT_RESIZE_FACTOR = 0.5;
+const double DETECT_MIN_RESIZE_FACTOR = 0.25;
+const double DETECT_MAX_RESIZE_FACTOR = 1.0;
+const double DETECT_TARGET_LATENCY = 0.025;
 
 @interface CaptureViewController () <CvVideoCameraDelegate> {
     FaceDetector *faceDetector;
+    FramePool *framePool;
+    ResizeFactorController *resizeFactorController;
     std::vector<Face> detectedFaces;
     Face bestDetectedFace;
     Face faceToMerge0;
@@ -79,6 +91,14 @@ const double DETECT_RESIZE_FACTOR = 0.5;
 - (void)viewDidLoad {
     [super viewDidLoad];
     
+    if (framePool == NULL) {
+        framePool = new FramePool();
+    }
+    
+    if (resizeFactorController == NULL) {
+        resizeFactorController = new ResizeFactorController(DETECT_TARGET_LATENCY, DETECT_RESIZE_FACTOR, DETECT_MIN_RESIZE_FACTOR, DETECT_MAX_RESIZE_FACTOR);
+    }
+    
     if (faceDetector == NULL) {
         
         NSBundle *bundle = [NSBundle mainBundle];
@@ -88,7 +108,7 @@ const double DETECT_RESIZE_FACTOR = 0.5;
         std::string leftEyeCascadePath = [[bundle pathForResource:@"haarcascade_lefteye_2splits" ofType:@"xml"] UTF8String];
         std::string rightEyeCascadePath = [[bundle pathForResource:@"haarcascade_righteye_2splits" ofType:@"xml"] UTF8String];
         
-        faceDetector = new FaceDetector(humanFaceCascadePath, catFaceCascadePath, leftEyeCascadePath, rightEyeCascadePath);
+        faceDetector = new FaceDetector(humanFaceCascadePath, catFaceCascadePath, leftEyeCascadePath, rightEyeCascadePath, framePool);
     }
     
     self.face0Button.enabled = NO;
@@ -138,6 +158,15 @@ const double DETECT_RESIZE_FACTOR = 0.5;
         delete faceDetector;
         faceDetector = NULL;
     }
+    
+    // Free the idle cascades, which the deleted detector returned, but
+    // keep one of each, so that the detector is quick to re-create.
+    CascadeCache::getInstance().trim();
+    
+    if (framePool != NULL) {
+        // Free the idle buffers.
+        framePool->clear();
+    }
 }
 
 - (void)dealloc {
@@ -145,6 +174,14 @@ const double DETECT_RESIZE_FACTOR = 0.5;
         delete faceDetector;
         faceDetector = NULL;
     }
+    if (resizeFactorController != NULL) {
+        delete resizeFactorController;
+        resizeFactorController = NULL;
+    }
+    if (framePool != NULL) {
+        delete framePool;
+        framePool = NULL;
+    }
 }
 
 - (IBAction)onTapToSetPointOfInterest:(UITapGestureRecognizer *)tapGesture {
@@ -218,8 +255,11 @@ const double DETECT_RESIZE_FACTOR = 0.5;
             break;
     }
     
-    // Detect and draw any faces.
-    faceDetector->detect(mat, detectedFaces, DETECT_RESIZE_FACTOR, true);
+    // Detect and draw any faces, at a resize factor that adapts to the
+    // latency.
+    double resizeFactor = resizeFactorController->beginFrame();
+    faceDetector->detect(mat, detectedFaces, resizeFactor, true);
+    resizeFactorController->endFrame();
     
     BOOL didDetectFaces = (detectedFaces.size() > 0);
     
@@ -0,0 +1,155 @@
+//
+//  CascadeCache.cpp
+//  ManyMasks
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "CascadeCache.h"
+
+CascadeCache &CascadeCache::getInstance() {
+    
+    // The instance is created on first use, in a thread-safe way, and is
+    // never destroyed, so that leases may be released during shutdown.
+    static CascadeCache *instance = new CascadeCache();
+    return *instance;
+}
+
+CascadeCache::CascadeCache(size_t maxNumIdleClassifiersPerPath)
+: state(std::make_shared<State>())
+{
+    state->maxNumIdleClassifiersPerPath = maxNumIdleClassifiersPerPath;
+    state->numLoads = 0;
+}
+
+size_t CascadeCache::getMaxNumIdleClassifiers(const State &state, const std::string &path) {
+    std::map<std::string, size_t>::const_iterator it = state.maxNumIdleClassifiersByPath.find(path);
+    if (it == state.maxNumIdleClassifiersByPath.end()) {
+        return state.maxNumIdleClassifiersPerPath;
+    }
+    return MAX(it->second, state.maxNumIdleClassifiersPerPath);
+}
+
+CascadeCache::Lease CascadeCache::lease(const std::string &path) {
+    
+    // Reuse an idle classifier for the path, if any.
+    std::unique_ptr<cv::CascadeClassifier> classifier;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        std::vector<std::unique_ptr<cv::CascadeClassifier>> &classifiers = state->idleClassifiers[path];
+        if (classifiers.empty()) {
+            state->numLoads++;
+        } else {
+            classifier = std::move(classifiers.back());
+            classifiers.pop_back();
+        }
+    }
+    
+    // Otherwise, parse the file, without holding the lock, so that other
+    // paths can be leased meanwhile.
+    if (!classifier) {
+        classifier.reset(new cv::CascadeClassifier(path));
+    }
+    
+    // The deleter returns the classifier to the cache.
+    std::shared_ptr<State> sharedState = state;
+    return Lease(classifier.release(), [sharedState, path](cv::CascadeClassifier *classifier) {
+        std::unique_ptr<cv::CascadeClassifier> ownedClassifier(classifier);
+        std::lock_guard<std::mutex> lock(sharedState->mutex);
+        std::vector<std::unique_ptr<cv::CascadeClassifier>> &classifiers = sharedState->idleClassifiers[path];
+        if (classifiers.size() < getMaxNumIdleClassifiers(*sharedState, path)) {
+            classifiers.push_back(std::move(ownedClassifier));
+        }
+    });
+}
+
+void CascadeCache::prewarm(const std::string &path, size_t numClassifiers) {
+    
+    size_t numMissingClassifiers;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        size_t &maxNumIdleClassifiers = state->maxNumIdleClassifiersByPath[path];
+        maxNumIdleClassifiers = MAX(maxNumIdleClassifiers, numClassifiers);
+        size_t numIdleClassifiers = state->idleClassifiers[path].size();
+        if (numIdleClassifiers >= numClassifiers) {
+            return;
+        }
+        numMissingClassifiers = numClassifiers - numIdleClassifiers;
+        state->numLoads++;
+    }
+    
+    // Parse the file once, without holding the lock, and build each
+    // classifier from the parsed tree.
+    std::vector<std::unique_ptr<cv::CascadeClassifier>> classifiers;
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    for (size_t i = 0; i < numMissingClassifiers; i++) {
+        std::unique_ptr<cv::CascadeClassifier> classifier(new cv::CascadeClassifier());
+        if (!fs.isOpened() || !classifier->read(fs.getFirstTopLevelNode())) {
+            // The file is missing, or it is in the old format, which
+            // only load can read.
+            classifier->load(path);
+        }
+        classifiers.push_back(std::move(classifier));
+    }
+    fs.release();
+    
+    std::lock_guard<std::mutex> lock(state->mutex);
+    std::vector<std::unique_ptr<cv::CascadeClassifier>> &idleClassifiers = state->idleClassifiers[path];
+    for (std::unique_ptr<cv::CascadeClassifier> &classifier : classifiers) {
+        idleClassifiers.push_back(std::move(classifier));
+    }
+}
+
+void CascadeCache::trim(size_t numClassifiersToKeepPerPath) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (auto &entry : state->idleClassifiers) {
+        if (entry.second.size() > numClassifiersToKeepPerPath) {
+            entry.second.resize(numClassifiersToKeepPerPath);
+        }
+    }
+}
+
+void CascadeCache::clear() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->idleClassifiers.clear();
+}
+
+size_t CascadeCache::getNumLoads() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->numLoads;
+}
+
+size_t CascadeCache::getNumIdleClassifiers() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    size_t numIdleClassifiers = 0;
+    for (const auto &entry : state->idleClassifiers) {
+        numIdleClassifiers += entry.second.size();
+    }
+    return numIdleClassifiers;
+}
@@ -0,0 +1,137 @@
+//
+//  CascadeCache.h
+//  ManyMasks
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef CASCADE_CACHE_H
+#define CASCADE_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/objdetect.hpp>
+
+/**
+ * A process-wide cache of parsed cascade classifiers, keyed by path.
+ * Parsing a cascade's XML file dominates a detector's startup, so each
+ * file is parsed only when no parsed copy is idle. A classifier is not
+ * safe to use from several threads at once, so each is leased to one
+ * user at a time, and returns to the cache when the lease is released.
+ * Detectors that are created one after another, or re-created after
+ * being freed, therefore reuse the same parsed models.
+ * The cache is thread-safe.
+ */
+class CascadeCache
+{
+public:
+    /**
+     * A classifier that is leased for exclusive use.
+     * It returns to the cache when the last copy of the lease is released.
+     */
+    typedef std::shared_ptr<cv::CascadeClassifier> Lease;
+    
+    /**
+     * Get the process-wide cache.
+     */
+    static CascadeCache &getInstance();
+    
+    /**
+     * Construct a cache that keeps up to maxNumIdleClassifiersPerPath
+     * unused classifiers for each path. Any more are freed when released.
+     */
+    CascadeCache(size_t maxNumIdleClassifiersPerPath = 4);
+    
+    /**
+     * Lease the classifier that is stored at the given path, parsing it
+     * only if no parsed copy is idle.
+     * If the file cannot be loaded, the classifier is empty.
+     */
+    Lease lease(const std::string &path);
+    
+    /**
+     * Ensure that at least numClassifiers parsed copies of the classifier
+     * at the given path are idle, parsing the file at most once, and
+     * raise the path's idle limit to at least numClassifiers, so that
+     * they are kept when released.
+     * Call this before creating several users of the same path, such as
+     * a pool's workers, so that they do not each parse the file.
+     */
+    void prewarm(const std::string &path, size_t numClassifiers);
+    
+    /**
+     * Free idle classifiers, but keep up to numClassifiersToKeepPerPath
+     * of them for each path, so that the next user need not parse the
+     * file again.
+     */
+    void trim(size_t numClassifiersToKeepPerPath = 1);
+    
+    /**
+     * Free all idle classifiers.
+     */
+    void clear();
+    
+    /**
+     * Get the number of times that the cache has parsed a file.
+     * Once the cache is warm, this stops increasing.
+     */
+    size_t getNumLoads() const;
+    
+    size_t getNumIdleClassifiers() const;
+    
+private:
+    struct State {
+        std::mutex mutex;
+        std::map<std::string, std::vector<std::unique_ptr<cv::CascadeClassifier>>> idleClassifiers;
+        size_t maxNumIdleClassifiersPerPath;
+        
+        /**
+         * The idle limits that were raised by prewarming, by path.
+         */
+        std::map<std::string, size_t> maxNumIdleClassifiersByPath;
+        size_t numLoads;
+    };
+    
+    /**
+     * Get the number of idle classifiers to keep for the given path.
+     * The state's mutex must be held.
+     */
+    static size_t getMaxNumIdleClassifiers(const State &state, const std::string &path);
+    
+    /**
+     * The state is shared with the leases, so that they may safely
+     * outlive the cache.
+     */
+    std::shared_ptr<State> state;
+};
+
+#endif // !CASCADE_CACHE_H
@@ -0,0 +1,208 @@
+//
+//  ManyMasksChecks.cpp
+//  ManyMasks
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  A headless program that measures the face detector pool's throughput
+//  with several streams and checks that each stream's frames are
+//  processed in order, one at a time. It depends only on OpenCV.
+//  Build it from this directory with:
+//
+//    c++ -std=c++11 -O2 -pthread -I.. ../CascadeCache.cpp ../Face.cpp
+//        ../FaceDetector.cpp ../FaceDetectorPool.cpp ../FramePool.cpp
+//        ../FramePreprocessingCache.cpp ../GeomUtils.cpp
+//        ManyMasksChecks.cpp $(pkg-config --cflags --libs opencv)
+//        -o ManyMasksChecks
+//
+//  Run it with the directory of the bundled cascades and, optionally, an
+//  image of faces, which is scaled to 720p:
+//
+//    ./ManyMasksChecks .. faces.jpg
+//
+//  Without an image, it uses a noisy frame, which has no faces but still
+//  costs a full search. It prints its measurements, and exits with a
+//  nonzero status if any invariant does not hold.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "FaceDetector.h"
+#include "FaceDetectorPool.h"
+
+const double SECONDS_PER_RUN = 5.0;
+const double RESIZE_FACTOR = 0.5;
+
+typedef std::chrono::steady_clock Clock;
+
+static int numFailures = 0;
+
+static void check(bool condition, const char *description) {
+    printf("  [%s] %s\n", condition ? "pass" : "FAIL", description);
+    if (!condition) {
+        numFailures++;
+    }
+}
+
+static double getSecondsSince(const Clock::time_point &start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * The order and overlap of one stream's callbacks.
+ */
+struct StreamRecord {
+    uint64_t lastFrameID;
+    bool hasFrames;
+    size_t numOutOfOrderFrames;
+    size_t numOverlappingFrames;
+    std::atomic<int> numFramesInProgress;
+
+    StreamRecord()
+    : lastFrameID(0ull)
+    , hasFrames(false)
+    , numOutOfOrderFrames(0)
+    , numOverlappingFrames(0)
+    , numFramesInProgress(0)
+    {
+    }
+};
+
+int main(int argc, char *argv[]) {
+    std::string cascadeDirectory = (argc > 1) ? argv[1] : "..";
+    std::string humanFaceCascadePath = cascadeDirectory + "/haarcascade_frontalface_alt.xml";
+    std::string catFaceCascadePath = cascadeDirectory + "/haarcascade_frontalcatface_extended.xml";
+    std::string humanLeftEyeCascadePath = cascadeDirectory + "/haarcascade_lefteye_2splits.xml";
+    std::string humanRightEyeCascadePath = cascadeDirectory + "/haarcascade_righteye_2splits.xml";
+
+    cv::Mat frame;
+    if (argc > 2) {
+        frame = cv::imread(argv[2], cv::IMREAD_COLOR);
+        if (frame.empty()) {
+            printf("cannot read %s\n", argv[2]);
+            return 1;
+        }
+        cv::resize(frame, frame, cv::Size(1280, 720), 0.0, 0.0, cv::INTER_AREA);
+    } else {
+        frame.create(720, 1280, CV_8UC3);
+        cv::RNG rng(0x5eed);
+        rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar::all(0.0), cv::Scalar::all(256.0));
+    }
+    cv::cvtColor(frame, frame, cv::COLOR_BGR2BGRA);
+
+    // Measure one detector on the submitting thread, as a baseline.
+    printf("Face detector pool throughput\n");
+    FaceDetector detector(humanFaceCascadePath, catFaceCascadePath, humanLeftEyeCascadePath, humanRightEyeCascadePath);
+    std::vector<Face> faces;
+    cv::Mat serialFrame = frame.clone();
+    int numSerialFrames = 0;
+    Clock::time_point startTime = Clock::now();
+    while (getSecondsSince(startTime) < SECONDS_PER_RUN) {
+        detector.detect(serialFrame, faces, RESIZE_FACTOR);
+        numSerialFrames++;
+    }
+    double serialFramesPerSecond = numSerialFrames / getSecondsSince(startTime);
+    printf("  one detector: %8.2f FPS, %zu faces\n", serialFramesPerSecond, faces.size());
+
+    FaceDetectorPool pool(humanFaceCascadePath, catFaceCascadePath, humanLeftEyeCascadePath, humanRightEyeCascadePath);
+    printf("  the pool has %zu workers on %d CPUs\n", pool.getNumWorkers(), cv::getNumberOfCPUs());
+
+    for (int numStreams = 1; numStreams <= 16; numStreams *= 2) {
+        std::map<int, StreamRecord> records;
+        for (int streamID = 0; streamID < numStreams; streamID++) {
+            records[streamID];
+        }
+        std::mutex recordsMutex;
+
+        FaceDetectorPool::Callback callback = [&](int streamID, uint64_t frameID, cv::Mat &, std::vector<Face> &) {
+            StreamRecord &record = records[streamID];
+            bool overlapping = (++record.numFramesInProgress > 1);
+            {
+                std::lock_guard<std::mutex> lock(recordsMutex);
+                if (overlapping) {
+                    record.numOverlappingFrames++;
+                }
+                if (record.hasFrames && frameID <= record.lastFrameID) {
+                    record.numOutOfOrderFrames++;
+                }
+                record.lastFrameID = frameID;
+                record.hasFrames = true;
+            }
+            record.numFramesInProgress--;
+        };
+
+        // Submit frames from every stream at each stream's own pace, as
+        // cameras would, for a fixed time. The streams' queues drop the
+        // frames that the pool cannot keep up with.
+        pool.resetStats();
+        startTime = Clock::now();
+        while (getSecondsSince(startTime) < SECONDS_PER_RUN) {
+            for (int streamID = 0; streamID < numStreams; streamID++) {
+                pool.submit(streamID, frame, callback, RESIZE_FACTOR);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        pool.waitUntilIdle();
+        FaceDetectorPool::Stats stats = pool.getStats();
+        printf("  %2d streams: %8.2f FPS (%.2fx one detector), %llu processed, %llu dropped, %llu failed\n", numStreams, stats.framesPerSecond, stats.framesPerSecond / serialFramesPerSecond, (unsigned long long)stats.numProcessedFrames, (unsigned long long)stats.numDroppedFrames, (unsigned long long)stats.numFailedFrames);
+
+        size_t numOutOfOrderFrames = 0;
+        size_t numOverlappingFrames = 0;
+        size_t numStreamsWithFrames = 0;
+        for (const auto &entry : records) {
+            numOutOfOrderFrames += entry.second.numOutOfOrderFrames;
+            numOverlappingFrames += entry.second.numOverlappingFrames;
+            numStreamsWithFrames += entry.second.hasFrames ? 1 : 0;
+        }
+
+        char description[128];
+        snprintf(description, sizeof(description), "%d streams: every stream is served (%zu served)", numStreams, numStreamsWithFrames);
+        check(numStreamsWithFrames == (size_t)numStreams, description);
+        snprintf(description, sizeof(description), "%d streams: each stream's frames arrive in order (%zu out of order)", numStreams, numOutOfOrderFrames);
+        check(numOutOfOrderFrames == 0, description);
+        snprintf(description, sizeof(description), "%d streams: each stream's frames are processed one at a time (%zu overlapping)", numStreams, numOverlappingFrames);
+        check(numOverlappingFrames == 0, description);
+        snprintf(description, sizeof(description), "%d streams: no frame fails", numStreams);
+        check(stats.numFailedFrames == 0, description);
+    }
+
+    printf("%d failures\n", numFailures);
+    return (numFailures == 0) ? 0 : 1;
+}
@@ -35,25 +35,44 @@
 
 #include "Face.h"
 
-Face::Face(Species species, const cv::Mat &mat, const cv::Point2f &leftEyeCenter, const cv::Point2f &rightEyeCenter, const cv::Point2f &noseTip)
+Face::Face(Species species, const cv::Mat &mat, const cv::Point2f &leftEyeCenter, const cv::Point2f &rightEyeCenter, const cv::Point2f &noseTip, const cv::Rect2f &rect)
 : species(species)
 , leftEyeCenter(leftEyeCenter)
 , rightEyeCenter(rightEyeCenter)
 , noseTip(noseTip)
+, rect(rect)
 {
     mat.copyTo(this->mat);
 }
 
+Face::Face(Species species, const cv::Mat &mat, const cv::Point2f &leftEyeCenter, const cv::Point2f &rightEyeCenter, const cv::Point2f &noseTip, FramePool &framePool, const cv::Rect2f &rect)
+: species(species)
+, matLease(framePool.leaseCopy(mat))
+, leftEyeCenter(leftEyeCenter)
+, rightEyeCenter(rightEyeCenter)
+, noseTip(noseTip)
+, rect(rect)
+{
+    this->mat = *matLease;
+}
+
 Face::Face() {
 }
 
 Face::Face(const Face &other)
 : species(other.species)
+, matLease(other.matLease)
 , leftEyeCenter(other.leftEyeCenter)
 , rightEyeCenter(other.rightEyeCenter)
 , noseTip(other.noseTip)
+, rect(other.rect)
 {
-    other.mat.copyTo(mat);
+    if (matLease) {
+        // Share the leased buffer.
+        mat = other.mat;
+    } else {
+        other.mat.copyTo(mat);
+    }
 }
 
 Face::Face(const Face &face0, const Face &face1) {
@@ -96,6 +115,10 @@ const cv::Point2f &Face::getNoseTip() const {
     return noseTip;
 }
 
+const cv::Rect2f &Face::getRect() const {
+    return rect;
+}
+
 void Face::initMergedFace(const Face &biggerFace, const Face &smallerFace) {
     
     // Determine the species of the merged face.
@@ -171,4 +194,5 @@ void Face::initMergedFace(const Face &biggerFace, const Face &smallerFace) {
     leftEyeCenter = biggerFace.leftEyeCenter;
     rightEyeCenter = biggerFace.rightEyeCenter;
     noseTip = biggerFace.noseTip;
+    rect = biggerFace.rect;
 }
@@ -36,12 +36,25 @@
 
 #include <opencv2/core.hpp>
 
+#include "FramePool.h"
 #include "Species.h"
 
 class Face {
 
 public:
-    Face(Species species, const cv::Mat &mat, const cv::Point2f &leftEyeCenter, const cv::Point2f &rightEyeCenter, const cv::Point2f &noseTip);
+    /**
+     * Construct a face. The eyes and nose are relative to the image.
+     * The rectangle is the face's location in the scene, with sub-pixel
+     * precision, if known.
+     */
+    Face(Species species, const cv::Mat &mat, const cv::Point2f &leftEyeCenter, const cv::Point2f &rightEyeCenter, const cv::Point2f &noseTip, const cv::Rect2f &rect = cv::Rect2f());
+    
+    /**
+     * Construct a face whose image is copied into a buffer leased from
+     * the pool. Copies of the face share the leased buffer instead of
+     * copying it.
+     */
+    Face(Species species, const cv::Mat &mat, const cv::Point2f &leftEyeCenter, const cv::Point2f &rightEyeCenter, const cv::Point2f &noseTip, FramePool &framePool, const cv::Rect2f &rect = cv::Rect2f());
     
     /**
      * Construct an empty face.
@@ -70,16 +83,26 @@ public:
     const cv::Point2f &getRightEyeCenter() const;
     const cv::Point2f &getNoseTip() const;
     
+    /**
+     * Get the face's location in the scene, with sub-pixel precision.
+     * The image is this rectangle, rounded outward to whole pixels and
+     * clipped to the scene. A merged face has the bigger face's location.
+     */
+    const cv::Rect2f &getRect() const;
+    
 private:
     void initMergedFace(const Face &biggerFace, const Face &smallerFace);
     
     Species species;
     
     cv::Mat mat;
+    FramePool::Lease matLease;
     
     cv::Point2f leftEyeCenter;
     cv::Point2f rightEyeCenter;
     cv::Point2f noseTip;
+    
+    cv::Rect2f rect;
 };
 
 #endif // !FACE_H
@@ -36,12 +36,6 @@
 #include "FaceDetector.h"
 #include "GeomUtils.h"
 
-#ifdef WITH_CLAHE
-#define EQUALIZE(src, dst) clahe->apply(src, dst)
-#else
-#define EQUALIZE(src, dst) cv::equalizeHist(src, dst)
-#endif
-
 const double DETECT_HUMAN_FACE_SCALE_FACTOR = 1.4;
 const int DETECT_HUMAN_FACE_MIN_NEIGHBORS = 4;
 const int DETECT_HUMAN_FACE_RELATIVE_MIN_SIZE_IN_IMAGE = 0.25;
@@ -78,43 +72,52 @@ const cv::Scalar DRAW_NOSE_COLOR(255, 0, 0); // Blue
 
 const int DRAW_RADIUS = 4;
 
-FaceDetector::FaceDetector(const std::string &humanFaceCascadePath, const std::string &catFaceCascadePath, const std::string &humanLeftEyeCascadePath, const std::string &humanRightEyeCascadePath)
-: humanFaceClassifier(humanFaceCascadePath)
-, catFaceClassifier(catFaceCascadePath)
-, humanLeftEyeClassifier(humanLeftEyeCascadePath)
-, humanRightEyeClassifier(humanRightEyeCascadePath)
+FaceDetector::FaceDetector(const std::string &humanFaceCascadePath, const std::string &catFaceCascadePath, const std::string &humanLeftEyeCascadePath, const std::string &humanRightEyeCascadePath, FramePool *framePool)
+: humanFaceClassifier(CascadeCache::getInstance().lease(humanFaceCascadePath))
+, catFaceClassifier(CascadeCache::getInstance().lease(catFaceCascadePath))
+, humanLeftEyeClassifier(CascadeCache::getInstance().lease(humanLeftEyeCascadePath))
+, humanRightEyeClassifier(CascadeCache::getInstance().lease(humanRightEyeCascadePath))
+, framePool(framePool)
 #ifdef WITH_CLAHE
-, clahe(cv::createCLAHE())
+, privatePreprocessingCache(cv::createCLAHE())
 #endif
 {
 }
 
 void FaceDetector::detect(cv::Mat &image, std::vector<Face> &faces, double resizeFactor, bool draw)
+{
+    // Treat the image as a new frame.
+    privatePreprocessingCache.clear();
+    privatePreprocessingCache.setFrame(image, 0ull, resizeFactor);
+    detect(privatePreprocessingCache, faces, draw);
+    
+    // Do not hold a reference to the caller's image.
+    privatePreprocessingCache.clear();
+}
+
+void FaceDetector::detect(FramePreprocessingCache &preprocessingCache, std::vector<Face> &faces, bool draw)
 {
     faces.clear();
     
-    if (resizeFactor == 1.0) {
-        equalize(image);
-    } else {
-        cv::resize(image, resizedImage, cv::Size(), resizeFactor, resizeFactor, cv::INTER_AREA);
-        equalize(resizedImage);
-    }
+    cv::Mat &image = preprocessingCache.getImage();
+    double resizeFactor = preprocessingCache.getResizeFactor();
+    const cv::Mat &equalizedImage = preprocessingCache.getEqualizedImage();
     
     // Detect human faces.
     std::vector<cv::Rect> humanFaceRects;
     int detectHumanFaceMinWidth = MIN(image.cols, image.rows) * DETECT_HUMAN_FACE_RELATIVE_MIN_SIZE_IN_IMAGE;
     cv::Size detectHumanFaceMinSize(detectHumanFaceMinWidth, detectHumanFaceMinWidth);
-    humanFaceClassifier.detectMultiScale(equalizedImage, humanFaceRects, DETECT_HUMAN_FACE_SCALE_FACTOR, DETECT_HUMAN_FACE_MIN_NEIGHBORS, 0, detectHumanFaceMinSize);
+    humanFaceClassifier->detectMultiScale(equalizedImage, humanFaceRects, DETECT_HUMAN_FACE_SCALE_FACTOR, DETECT_HUMAN_FACE_MIN_NEIGHBORS, 0, detectHumanFaceMinSize);
     
     // Detect cat faces.
     std::vector<cv::Rect> catFaceRects;
     int detectCatFaceMinWidth = MIN(image.cols, image.rows) * DETECT_CAT_FACE_RELATIVE_MIN_SIZE_IN_IMAGE;
     cv::Size detectCatFaceMinSize(detectCatFaceMinWidth, detectCatFaceMinWidth);
-    catFaceClassifier.detectMultiScale(equalizedImage, catFaceRects, DETECT_CAT_FACE_SCALE_FACTOR, DETECT_CAT_FACE_MIN_NEIGHBORS, 0, detectCatFaceMinSize);
+    catFaceClassifier->detectMultiScale(equalizedImage, catFaceRects, DETECT_CAT_FACE_SCALE_FACTOR, DETECT_CAT_FACE_MIN_NEIGHBORS, 0, detectCatFaceMinSize);
     
     for (cv::Rect &humanFaceRect : humanFaceRects) {
         // Evaluate the human face.
-        detectInnerComponents(image, faces, resizeFactor, draw, Human, humanFaceRect);
+        detectInnerComponents(image, equalizedImage, faces, resizeFactor, draw, Human, humanFaceRect);
         
         // Discard cat faces that intersect the human face.
         // (The human face detector is more reliable.)
@@ -125,28 +128,11 @@ void FaceDetector::detect(cv::Mat &image, std::vector<Face> &faces, double resiz
     
     for (cv::Rect &catFaceRect : catFaceRects) {
         // Evaluate the cat face.
-        detectInnerComponents(image, faces, resizeFactor, draw, Cat, catFaceRect);
-    }
-}
-
-void FaceDetector::equalize(const cv::Mat &image) {
-    switch (image.channels()) {
-        case 4:
-            cv::cvtColor(image, equalizedImage, cv::COLOR_BGRA2GRAY);
-            EQUALIZE(equalizedImage, equalizedImage);
-            break;
-        case 3:
-            cv::cvtColor(image, equalizedImage, cv::COLOR_BGR2GRAY);
-            EQUALIZE(equalizedImage, equalizedImage);
-            break;
-        default:
-            // Assume the image is already grayscale.
-            EQUALIZE(image, equalizedImage);
-            break;
+        detectInnerComponents(image, equalizedImage, faces, resizeFactor, draw, Cat, catFaceRect);
     }
 }
 
-void FaceDetector::detectInnerComponents(cv::Mat &image, std::vector<Face> &faces, double resizeFactor, bool draw, Species species, cv::Rect faceRect)
+void FaceDetector::detectInnerComponents(cv::Mat &image, const cv::Mat &equalizedImage, std::vector<Face> &faces, double resizeFactor, bool draw, Species species, cv::Rect faceRect)
 {
     cv::Range rowRange(faceRect.y, faceRect.y + faceRect.height);
     cv::Range colRange(faceRect.x, faceRect.x + faceRect.width);
@@ -171,7 +157,7 @@ void FaceDetector::detectInnerComponents(cv::Mat &image, std::vector<Face> &face
         
         // Try to detect the left eye.
         std::vector<cv::Rect> leftEyeRects;
-        humanLeftEyeClassifier.detectMultiScale(equalizedFaceMat.colRange(0, halfFaceWidth), leftEyeRects, DETECT_HUMAN_EYE_SCALE_FACTOR, DETECT_HUMAN_EYE_MIN_NEIGHBORS, 0, eyeMinSize);
+        humanLeftEyeClassifier->detectMultiScale(equalizedFaceMat.colRange(0, halfFaceWidth), leftEyeRects, DETECT_HUMAN_EYE_SCALE_FACTOR, DETECT_HUMAN_EYE_MIN_NEIGHBORS, 0, eyeMinSize);
         if (leftEyeRects.size() > 0) {
             leftEyeRect = leftEyeRects[0];
             leftEyeCenter.x = leftEyeRect.x + ESTIMATE_HUMAN_EYE_CENTER_RELATIVE_X_IN_EYE * leftEyeRect.width;
@@ -184,7 +170,7 @@ void FaceDetector::detectInnerComponents(cv::Mat &image, std::vector<Face> &face
         
         // Try to detect the right eye.
         std::vector<cv::Rect> rightEyeRects;
-        humanRightEyeClassifier.detectMultiScale(equalizedFaceMat.colRange(halfFaceWidth, faceWidth), rightEyeRects, DETECT_HUMAN_EYE_SCALE_FACTOR, DETECT_HUMAN_EYE_MIN_NEIGHBORS, 0, eyeMinSize);
+        humanRightEyeClassifier->detectMultiScale(equalizedFaceMat.colRange(halfFaceWidth, faceWidth), rightEyeRects, DETECT_HUMAN_EYE_SCALE_FACTOR, DETECT_HUMAN_EYE_MIN_NEIGHBORS, 0, eyeMinSize);
         if (rightEyeRects.size() > 0) {
             rightEyeRect = rightEyeRects[0];
             // Adjust the right eye rect to be relative to the whole face.
@@ -220,48 +206,40 @@ void FaceDetector::detectInnerComponents(cv::Mat &image, std::vector<Face> &face
         noseTip.y = ESTIMATE_CAT_NOSE_TIP_RELATIVE_Y_IN_FACE * faceRect.height;
     }
     
-    // Restore everything to the original scale.
-    
-    faceRect.x /= resizeFactor;
-    faceRect.y /= resizeFactor;
-    faceRect.width /= resizeFactor;
-    faceRect.height /= resizeFactor;
-    
-    rowRange.start /= resizeFactor;
-    rowRange.end /= resizeFactor;
-    
-    colRange.start /= resizeFactor;
-    colRange.end /= resizeFactor;
-    
-    cv::Mat faceMat(image, rowRange, colRange);
-    
-    leftEyeRect.x /= resizeFactor;
-    leftEyeRect.y /= resizeFactor;
-    leftEyeRect.width /= resizeFactor;
-    leftEyeRect.height /= resizeFactor;
-    
-    rightEyeRect.x /= resizeFactor;
-    rightEyeRect.y /= resizeFactor;
-    rightEyeRect.width /= resizeFactor;
-    rightEyeRect.height /= resizeFactor;
-    
-    leftEyeCenter /= resizeFactor;
-    rightEyeCenter /= resizeFactor;
-    noseTip /= resizeFactor;
-    
-    faces.push_back(Face(species, faceMat, leftEyeCenter, rightEyeCenter, noseTip));
+    // Restore everything to the original scale, without rounding.
+    // Then, round the face outward to whole pixels and take it as an ROI.
+    double inverseResizeFactor = 1.0 / resizeFactor;
+    cv::Rect2f originalFaceRect = GeomUtils::scale(faceRect, inverseResizeFactor);
+    cv::Rect faceROI = GeomUtils::roundOutward(originalFaceRect) & cv::Rect(0, 0, image.cols, image.rows);
+    cv::Mat faceMat(image, faceROI);
+    
+    // The eyes and nose are relative to the face.
+    // Make them relative to the ROI, which may start slightly earlier.
+    cv::Point2f offsetInROI = originalFaceRect.tl() - cv::Point2f(faceROI.tl());
+    leftEyeCenter = leftEyeCenter * inverseResizeFactor + offsetInROI;
+    rightEyeCenter = rightEyeCenter * inverseResizeFactor + offsetInROI;
+    noseTip = noseTip * inverseResizeFactor + offsetInROI;
+    
+    if (framePool != NULL) {
+        faces.push_back(Face(species, faceMat, leftEyeCenter, rightEyeCenter, noseTip, *framePool, originalFaceRect));
+    } else {
+        faces.push_back(Face(species, faceMat, leftEyeCenter, rightEyeCenter, noseTip, originalFaceRect));
+    }
     
     if (draw) {
-        cv::rectangle(image, faceRect.tl(), faceRect.br(), isHuman ? DRAW_HUMAN_FACE_COLOR : DRAW_CAT_FACE_COLOR);
-        cv::circle(image, faceRect.tl() + cv::Point(leftEyeCenter), DRAW_RADIUS, DRAW_LEFT_EYE_COLOR);
-        cv::circle(image, faceRect.tl() + cv::Point(rightEyeCenter), DRAW_RADIUS, DRAW_RIGHT_EYE_COLOR);
-        cv::circle(image, faceRect.tl() + cv::Point(noseTip), DRAW_RADIUS, DRAW_NOSE_COLOR);
+        cv::rectangle(image, faceROI.tl(), faceROI.br(), isHuman ? DRAW_HUMAN_FACE_COLOR : DRAW_CAT_FACE_COLOR);
+        cv::circle(image, faceROI.tl() + cv::Point(leftEyeCenter), DRAW_RADIUS, DRAW_LEFT_EYE_COLOR);
+        cv::circle(image, faceROI.tl() + cv::Point(rightEyeCenter), DRAW_RADIUS, DRAW_RIGHT_EYE_COLOR);
+        cv::circle(image, faceROI.tl() + cv::Point(noseTip), DRAW_RADIUS, DRAW_NOSE_COLOR);
         
+        // The eyes' rectangles are relative to the face in the resized image.
         if (leftEyeRect.width > 0) {
-            cv::rectangle(image, faceRect.tl() + leftEyeRect.tl(), faceRect.tl() + leftEyeRect.br(), DRAW_LEFT_EYE_COLOR);
+            cv::Rect originalLeftEyeRect = GeomUtils::roundOutward(GeomUtils::scale(leftEyeRect + faceRect.tl(), inverseResizeFactor));
+            cv::rectangle(image, originalLeftEyeRect.tl(), originalLeftEyeRect.br(), DRAW_LEFT_EYE_COLOR);
         }
         if (rightEyeRect.width > 0) {
-            cv::rectangle(image, faceRect.tl() + rightEyeRect.tl(), faceRect.tl() + rightEyeRect.br(), DRAW_RIGHT_EYE_COLOR);
+            cv::Rect originalRightEyeRect = GeomUtils::roundOutward(GeomUtils::scale(rightEyeRect + faceRect.tl(), inverseResizeFactor));
+            cv::rectangle(image, originalRightEyeRect.tl(), originalRightEyeRect.br(), DRAW_RIGHT_EYE_COLOR);
         }
     }
 }
\ No newline at end of file
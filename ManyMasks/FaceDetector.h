@@ -36,30 +36,48 @@
 
 #include <opencv2/objdetect.hpp>
 
+#include "CascadeCache.h"
 #include "Face.h"
+#include "FramePool.h"
+#include "FramePreprocessingCache.h"
 
 class FaceDetector {
 
 public:
-    FaceDetector(const std::string &humanFaceCascadePath, const std::string &catFaceCascadePath, const std::string &humanLeftEyeCascadePath, const std::string &humanRightEyeCascadePath);
+    /**
+     * Construct a face detector.
+     * If a frame pool is given, the detected faces' images are leased
+     * from it, so that steady-state detection reuses their buffers.
+     * The pool must outlive the detector.
+     * The cascades are leased from the process-wide cascade cache, so
+     * that each file is only parsed once, however many detectors there
+     * are over time.
+     */
+    FaceDetector(const std::string &humanFaceCascadePath, const std::string &catFaceCascadePath, const std::string &humanLeftEyeCascadePath, const std::string &humanRightEyeCascadePath, FramePool *framePool = NULL);
     
     void detect(cv::Mat &image, std::vector<Face> &faces, double resizeFactor = 1.0, bool draw = false);
     
+    /**
+     * Detect faces in the preprocessing cache's current frame, at the
+     * cache's resize factor. The cache's equalized plane is reused if
+     * another consumer already computed it for the same frame.
+     */
+    void detect(FramePreprocessingCache &preprocessingCache, std::vector<Face> &faces, bool draw = false);
+    
 private:
-    void equalize(const cv::Mat &image);
-    void detectInnerComponents(cv::Mat &image, std::vector<Face> &faces, double resizeFactor, bool draw, Species species, cv::Rect faceRect);
+    void detectInnerComponents(cv::Mat &image, const cv::Mat &equalizedImage, std::vector<Face> &faces, double resizeFactor, bool draw, Species species, cv::Rect faceRect);
     
-    cv::CascadeClassifier humanFaceClassifier;
-    cv::CascadeClassifier catFaceClassifier;
-    cv::CascadeClassifier humanLeftEyeClassifier;
-    cv::CascadeClassifier humanRightEyeClassifier;
+    CascadeCache::Lease humanFaceClassifier;
+    CascadeCache::Lease catFaceClassifier;
+    CascadeCache::Lease humanLeftEyeClassifier;
+    CascadeCache::Lease humanRightEyeClassifier;
     
-#ifdef WITH_CLAHE
-    cv::Ptr<cv::CLAHE> clahe;
-#endif
+    FramePool *framePool;
     
-    cv::Mat resizedImage;
-    cv::Mat equalizedImage;
+    /**
+     * A private cache, used when the caller does not provide one.
+     */
+    FramePreprocessingCache privatePreprocessingCache;
 };
 
 #endif // !FACE_DETECTOR_H
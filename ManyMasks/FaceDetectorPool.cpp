@@ -0,0 +1,220 @@
+//
+//  FaceDetectorPool.cpp
+//  ManyMasks
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "FaceDetectorPool.h"
+
+FaceDetectorPool::FaceDetectorPool(const std::string &humanFaceCascadePath, const std::string &catFaceCascadePath, const std::string &humanLeftEyeCascadePath, const std::string &humanRightEyeCascadePath, size_t numWorkers, size_t maxQueueLengthPerStream, FramePool *facePool)
+: maxQueueLengthPerStream(MAX(maxQueueLengthPerStream, (size_t)1))
+, numBusyStreams(0)
+, stopping(false)
+{
+    resetStats();
+    
+    if (numWorkers == 0) {
+        numWorkers = (size_t)MAX(cv::getNumberOfCPUs(), 1);
+    }
+    
+    // Parse each cascade once, for all of the workers, and keep that
+    // many copies idle when the workers release them.
+    CascadeCache &cascadeCache = CascadeCache::getInstance();
+    cascadeCache.prewarm(humanFaceCascadePath, numWorkers);
+    cascadeCache.prewarm(catFaceCascadePath, numWorkers);
+    cascadeCache.prewarm(humanLeftEyeCascadePath, numWorkers);
+    cascadeCache.prewarm(humanRightEyeCascadePath, numWorkers);
+    
+    // Create the detectors before starting any worker, so that the
+    // workers do not compete with each other while the cascades load.
+    for (size_t i = 0; i < numWorkers; i++) {
+        detectors.emplace_back(new FaceDetector(humanFaceCascadePath, catFaceCascadePath, humanLeftEyeCascadePath, humanRightEyeCascadePath, facePool));
+    }
+    for (size_t i = 0; i < numWorkers; i++) {
+        workers.emplace_back(&FaceDetectorPool::run, this, detectors[i].get());
+    }
+}
+
+FaceDetectorPool::~FaceDetectorPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        streams.clear();
+        readyStreams.clear();
+    }
+    streamReady.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+uint64_t FaceDetectorPool::submit(int streamID, const cv::Mat &frame, const Callback &callback, double resizeFactor, bool draw) {
+    
+    // Copy the frame outside the lock, so that the workers are not blocked.
+    Job job;
+    job.frame = framePool.leaseCopy(frame);
+    job.resizeFactor = resizeFactor;
+    job.draw = draw;
+    job.callback = callback;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        std::map<int, Stream>::iterator streamIt = streams.find(streamID);
+        if (streamIt == streams.end()) {
+            Stream newStream;
+            newStream.nextFrameID = 0ull;
+            newStream.busy = false;
+            streamIt = streams.insert(std::make_pair(streamID, newStream)).first;
+        }
+        Stream &stream = streamIt->second;
+        
+        job.frameID = stream.nextFrameID++;
+        stats.numSubmittedFrames++;
+        
+        // Check whether the stream was idle before any frame is dropped.
+        // A stream with a full queue is already ready, and must not be
+        // added to the line twice.
+        bool wasIdle = stream.jobs.empty() && !stream.busy;
+        
+        if (stream.jobs.size() >= maxQueueLengthPerStream) {
+            // The oldest queued frame is stale. Drop it.
+            stream.jobs.pop_front();
+            stats.numDroppedFrames++;
+        }
+        
+        // If the stream was idle, it becomes ready.
+        if (wasIdle) {
+            readyStreams.push_back(streamID);
+        }
+        stream.jobs.push_back(job);
+    }
+    streamReady.notify_one();
+    
+    return job.frameID;
+}
+
+void FaceDetectorPool::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    frameProcessed.wait(lock, [this] {
+        return readyStreams.empty() && numBusyStreams == 0;
+    });
+}
+
+size_t FaceDetectorPool::getNumWorkers() const {
+    return workers.size();
+}
+
+FaceDetectorPool::Stats FaceDetectorPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    double elapsedTime = std::chrono::duration<double>(Clock::now() - statsResetTime).count();
+    if (elapsedTime > 0.0) {
+        result.framesPerSecond = stats.numProcessedFrames / elapsedTime;
+    }
+    return result;
+}
+
+void FaceDetectorPool::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.numSubmittedFrames = 0ull;
+    stats.numProcessedFrames = 0ull;
+    stats.numDroppedFrames = 0ull;
+    stats.numFailedFrames = 0ull;
+    stats.framesPerSecond = 0.0;
+    statsResetTime = Clock::now();
+}
+
+void FaceDetectorPool::run(FaceDetector *detector) {
+    
+    // Each worker reuses its own vector of faces.
+    std::vector<Face> faces;
+    
+    while (true) {
+        
+        int streamID;
+        Job job;
+        
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            streamReady.wait(lock, [this] {
+                return stopping || !readyStreams.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            
+            // Serve the stream at the front, and take its oldest frame.
+            streamID = readyStreams.front();
+            readyStreams.pop_front();
+            Stream &stream = streams[streamID];
+            job = stream.jobs.front();
+            stream.jobs.pop_front();
+            stream.busy = true;
+            numBusyStreams++;
+        }
+        
+        // A frame that fails is counted and skipped, so that it does not
+        // stop the worker or leave the stream busy.
+        bool success;
+        try {
+            detector->detect(*job.frame, faces, job.resizeFactor, job.draw);
+            job.callback(streamID, job.frameID, *job.frame, faces);
+            success = true;
+        } catch (const std::exception &) {
+            success = false;
+        }
+        
+        // Return the buffer to the pool before the next frame is taken.
+        job.frame.reset();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            numBusyStreams--;
+            stats.numProcessedFrames++;
+            if (!success) {
+                stats.numFailedFrames++;
+            }
+            
+            // If the stream has more frames, it goes to the back of the
+            // line, so that the other streams take their turns first.
+            std::map<int, Stream>::iterator streamIt = streams.find(streamID);
+            if (streamIt != streams.end()) {
+                Stream &stream = streamIt->second;
+                stream.busy = false;
+                if (!stream.jobs.empty()) {
+                    readyStreams.push_back(streamID);
+                    streamReady.notify_one();
+                }
+            }
+        }
+        frameProcessed.notify_all();
+    }
+}
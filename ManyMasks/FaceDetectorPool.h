@@ -0,0 +1,186 @@
+//
+//  FaceDetectorPool.h
+//  ManyMasks
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef FACE_DETECTOR_POOL_H
+#define FACE_DETECTOR_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "FaceDetector.h"
+#include "FramePool.h"
+
+/**
+ * A pool of worker threads that detect faces in frames from several
+ * streams, such as cameras.
+ * Each worker owns a detector, so the detectors' scratch state is never
+ * shared. Their cascades are leased from the process-wide cascade cache,
+ * which is prewarmed with one parsed copy per worker.
+ * A stream's frames are processed one at a time, in the order they were
+ * submitted, so its results are delivered in order. Streams that have
+ * frames waiting take turns, so a busy stream cannot starve the others.
+ * It has no dependencies on iOS, so it can also run headless.
+ */
+class FaceDetectorPool
+{
+public:
+    /**
+     * A function that is called on a worker thread with the faces that
+     * were detected in a copy of a submitted frame. The copy may be
+     * modified, for example, by drawing.
+     */
+    typedef std::function<void(int streamID, uint64_t frameID, cv::Mat &frame, std::vector<Face> &faces)> Callback;
+    
+    struct Stats {
+        uint64_t numSubmittedFrames;
+        uint64_t numProcessedFrames;
+        
+        /**
+         * The number of frames that were dropped because their stream's
+         * queue was full.
+         */
+        uint64_t numDroppedFrames;
+        
+        /**
+         * The number of processed frames whose detection or callback
+         * threw an exception. Their callbacks may not have been called.
+         */
+        uint64_t numFailedFrames;
+        
+        /**
+         * The number of frames processed per second, across all streams,
+         * since the stats were reset.
+         */
+        double framesPerSecond;
+    };
+    
+    /**
+     * Construct a pool with the given number of workers, or one per CPU
+     * if numWorkers is 0. Each stream queues up to
+     * maxQueueLengthPerStream frames that are not yet being processed.
+     * If a face pool is given, the detected faces' images are leased
+     * from it. It must outlive this pool.
+     */
+    FaceDetectorPool(const std::string &humanFaceCascadePath, const std::string &catFaceCascadePath, const std::string &humanLeftEyeCascadePath, const std::string &humanRightEyeCascadePath, size_t numWorkers = 0, size_t maxQueueLengthPerStream = 2, FramePool *facePool = NULL);
+    
+    /**
+     * Discard any queued frames, wait for the frames being processed,
+     * then stop the worker threads.
+     */
+    ~FaceDetectorPool();
+    
+    /**
+     * Copy a frame and queue it for detection.
+     * If the stream's queue is full, its oldest queued frame is dropped,
+     * so that the latency does not grow when the pool is overloaded.
+     * Returns the frame's ID, which increases with each frame of the
+     * stream.
+     */
+    uint64_t submit(int streamID, const cv::Mat &frame, const Callback &callback, double resizeFactor = 1.0, bool draw = false);
+    
+    /**
+     * Block until every queued frame has been processed.
+     */
+    void waitUntilIdle();
+    
+    size_t getNumWorkers() const;
+    
+    Stats getStats() const;
+    void resetStats();
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct Job {
+        FramePool::Lease frame;
+        uint64_t frameID;
+        double resizeFactor;
+        bool draw;
+        Callback callback;
+    };
+    
+    struct Stream {
+        std::deque<Job> jobs;
+        uint64_t nextFrameID;
+        
+        /**
+         * Whether a worker is processing one of the stream's frames.
+         */
+        bool busy;
+    };
+    
+    void run(FaceDetector *detector);
+    
+    size_t maxQueueLengthPerStream;
+    
+    /**
+     * A pool for the copies of submitted frames.
+     */
+    FramePool framePool;
+    
+    std::vector<std::unique_ptr<FaceDetector>> detectors;
+    
+    /**
+     * A mutex that guards all of the following members.
+     */
+    mutable std::mutex mutex;
+    std::condition_variable streamReady;
+    std::condition_variable frameProcessed;
+    
+    std::map<int, Stream> streams;
+    
+    /**
+     * The streams that have queued frames and are not busy, in the order
+     * in which they will be served. A stream goes to the back after each
+     * frame, so the streams take turns.
+     */
+    std::deque<int> readyStreams;
+    
+    size_t numBusyStreams;
+    bool stopping;
+    
+    Stats stats;
+    Clock::time_point statsResetTime;
+    
+    std::vector<std::thread> workers;
+};
+
+#endif // !FACE_DETECTOR_POOL_H
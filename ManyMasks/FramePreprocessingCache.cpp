@@ -0,0 +1,160 @@
+//
+//  FramePreprocessingCache.cpp
+//  ManyMasks
+//
+//  Created by Joseph Howse on 2026-10-19.
+//  Copyright © 2026 Nummist Media Corporation Limited. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//  (1) Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//  (2) Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//  (3) Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "FramePreprocessingCache.h"
+
+FramePreprocessingCache::FramePreprocessingCache(const cv::Ptr<cv::CLAHE> &clahe)
+: clahe(clahe)
+, frameID(0ull)
+, resizeFactor(1.0)
+, isResizedImageValid(false)
+, isGrayImageValid(false)
+, isEqualizedImageValid(false)
+, isFullScaleGrayImageValid(false)
+, isFullScaleEqualizedImageValid(false)
+{
+}
+
+void FramePreprocessingCache::setFrame(const cv::Mat &image, uint64_t frameID, double resizeFactor) {
+    if (hasFrame() && frameID == this->frameID && resizeFactor == this->resizeFactor) {
+        // The planes are still valid.
+        // Refresh the frame's header in case its data moved.
+        this->image = image;
+        return;
+    }
+    this->image = image;
+    this->frameID = frameID;
+    this->resizeFactor = resizeFactor;
+    isResizedImageValid = false;
+    isGrayImageValid = false;
+    isEqualizedImageValid = false;
+    isFullScaleGrayImageValid = false;
+    isFullScaleEqualizedImageValid = false;
+}
+
+void FramePreprocessingCache::clear() {
+    image.release();
+    isResizedImageValid = false;
+    isGrayImageValid = false;
+    isEqualizedImageValid = false;
+    isFullScaleGrayImageValid = false;
+    isFullScaleEqualizedImageValid = false;
+}
+
+bool FramePreprocessingCache::hasFrame() const {
+    return !image.empty();
+}
+
+uint64_t FramePreprocessingCache::getFrameID() const {
+    return frameID;
+}
+
+double FramePreprocessingCache::getResizeFactor() const {
+    return resizeFactor;
+}
+
+cv::Mat &FramePreprocessingCache::getImage() {
+    return image;
+}
+
+const cv::Mat &FramePreprocessingCache::getResizedImage() {
+    if (resizeFactor == 1.0) {
+        return image;
+    }
+    if (!isResizedImageValid) {
+        cv::resize(image, resizedImage, cv::Size(), resizeFactor, resizeFactor, cv::INTER_AREA);
+        isResizedImageValid = true;
+    }
+    return resizedImage;
+}
+
+const cv::Mat &FramePreprocessingCache::getGrayImage() {
+    if (!isGrayImageValid) {
+        convertToGray(getResizedImage(), grayImage);
+        isGrayImageValid = true;
+    }
+    return grayImage;
+}
+
+const cv::Mat &FramePreprocessingCache::getEqualizedImage() {
+    if (!isEqualizedImageValid) {
+        equalize(getGrayImage(), equalizedImage);
+        isEqualizedImageValid = true;
+    }
+    return equalizedImage;
+}
+
+const cv::Mat &FramePreprocessingCache::getFullScaleGrayImage() {
+    if (resizeFactor == 1.0) {
+        return getGrayImage();
+    }
+    if (!isFullScaleGrayImageValid) {
+        convertToGray(image, fullScaleGrayImage);
+        isFullScaleGrayImageValid = true;
+    }
+    return fullScaleGrayImage;
+}
+
+const cv::Mat &FramePreprocessingCache::getFullScaleEqualizedImage() {
+    if (resizeFactor == 1.0) {
+        return getEqualizedImage();
+    }
+    if (!isFullScaleEqualizedImageValid) {
+        equalize(getFullScaleGrayImage(), fullScaleEqualizedImage);
+        isFullScaleEqualizedImageValid = true;
+    }
+    return fullScaleEqualizedImage;
+}
+
+void FramePreprocessingCache::convertToGray(const cv::Mat &src, cv::Mat &dst) const {
+    switch (src.channels()) {
+        case 4:
+            cv::cvtColor(src, dst, cv::COLOR_BGRA2GRAY);
+            break;
+        case 3:
+            cv::cvtColor(src, dst, cv::COLOR_BGR2GRAY);
+            break;
+        default:
+            // Assume the image is already grayscale.
+            dst = src;
+            break;
+    }
+}
+
+void FramePreprocessingCache::equalize(const cv::Mat &src, cv::Mat &dst) const {
+    if (clahe.empty()) {
+        cv::equalizeHist(src, dst);
+    } else {
+        clahe->apply(src, dst);
+    }
+}
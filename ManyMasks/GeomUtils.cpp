@@ -31,8 +31,12 @@
 //  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+#include <cmath>
+
 #include "GeomUtils.h"
 
+const float ROUND_TOLERANCE = 1e-3f;
+
 bool GeomUtils::intersects(const cv::Rect &rect0, const cv::Rect &rect1)
 {
     return
@@ -40,4 +44,18 @@ bool GeomUtils::intersects(const cv::Rect &rect0, const cv::Rect &rect1)
         rect0.x + rect0.width  > rect1.x                &&
         rect0.y                < rect1.y + rect1.height &&
         rect0.y + rect0.height > rect1.y;
-}
\ No newline at end of file
+}
+
+cv::Rect2f GeomUtils::scale(const cv::Rect &rect, double factor)
+{
+    return cv::Rect2f((float)(rect.x * factor), (float)(rect.y * factor), (float)(rect.width * factor), (float)(rect.height * factor));
+}
+
+cv::Rect GeomUtils::roundOutward(const cv::Rect2f &rect)
+{
+    int left = (int)std::floor(rect.x + ROUND_TOLERANCE);
+    int top = (int)std::floor(rect.y + ROUND_TOLERANCE);
+    int right = (int)std::ceil(rect.x + rect.width - ROUND_TOLERANCE);
+    int bottom = (int)std::ceil(rect.y + rect.height - ROUND_TOLERANCE);
+    return cv::Rect(left, top, right - left, bottom - top);
+}
@@ -38,6 +38,21 @@
 
 namespace GeomUtils {
     bool intersects(const cv::Rect &rect0, const cv::Rect &rect1);
+    
+    /**
+     * Scale a rectangle without rounding. For example, a factor of
+     * 1.0 / resizeFactor maps a rectangle in a resized image to the
+     * original image. Coordinates refer to pixel edges, so pixel i spans
+     * [i, i + 1) and the mapping is the same for every corner.
+     */
+    cv::Rect2f scale(const cv::Rect &rect, double factor);
+    
+    /**
+     * Round a rectangle outward to whole pixels, so that it covers the
+     * original. Edges within a small tolerance of a whole pixel are
+     * rounded to it, so floating-point error does not grow the rectangle.
+     */
+    cv::Rect roundOutward(const cv::Rect2f &rect);
 }
 
 #endif // !GEOM_UTILS_H